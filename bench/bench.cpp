@@ -0,0 +1,347 @@
+// Micro-benchmarks for the file system core. Build from the repository root
+// with the same command line as the emulator:
+//
+//   g++ -std=c++17 -O2 -pthread bench/bench.cpp -o bench_fs
+//
+// and run "./bench_fs" for all of them or "./bench_fs <name>..." for some.
+// The wc kernel is picked at compile time: add -mavx2 for AVX2, or
+// -U__SSE2__ for the scalar loop.
+// Results for reference are kept in bench/RESULTS.md.
+
+#include "../filesystem.h"
+#include "../textcount.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace LinuxEmulator;
+
+// Every operator new the process makes, so a benchmark can report the heap
+// allocations behind an operation.
+static unsigned long long heapAllocations = 0;
+
+// Neither is inlined: GCC would otherwise see memory from operator new go
+// to free(), or from malloc() to operator delete (-Wmismatched-new-delete).
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    ++heapAllocations;
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    ::operator delete(pointer);
+}
+
+namespace {
+
+// The file system reports every step on std::cout; a benchmark discards it.
+class QuietOutput {
+public:
+    QuietOutput() : saved{std::cout.rdbuf(sink.rdbuf())} {}
+    ~QuietOutput() {
+        std::cout.rdbuf(saved);
+    }
+private:
+    std::ostringstream sink;
+    std::streambuf* saved;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Resident set size of the process, from /proc.
+std::size_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    std::size_t pages = 0;
+    std::size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// What "ls -l" and a recursive find read of every entry: name, type,
+// permissions and link count.
+std::size_t scanTree(const Node* node, std::size_t& checksum) {
+    std::size_t entries = 1;
+    for (const Node* child : node->children) {
+        checksum += child->getName().size() + static_cast<std::size_t>(child->data->getOctalPermissions()) +
+                    static_cast<std::size_t>(child->data->getLinkCount());
+        if (child->data->getIsDirectory()) {
+            entries += scanTree(child, checksum);
+        } else {
+            ++entries;
+        }
+    }
+    return entries;
+}
+
+// Reports the per-entry metadata footprint of a million-entry tree (1000
+// directories of 1000 files) and the time to scan all of it.
+void benchScan() {
+    std::size_t before = residentBytes();
+    FileSystem fs;
+    {
+        QuietOutput quiet;
+        for (std::size_t d = 0; d < 1000; ++d) {
+            std::string directory = "d" + std::to_string(d);
+            fs.createDirectory(directory);
+            for (std::size_t f = 0; f < 1000; ++f) {
+                fs.createFile("/" + directory + "/f" + std::to_string(f));
+            }
+        }
+    }
+    std::size_t resident = residentBytes() - before;
+    const Node* root = fs.findNode("/");
+    std::size_t checksum = 0;
+    std::size_t entries = 0;
+    double best = 0;
+    for (int pass = 0; pass < 5; ++pass) {
+        auto start = std::chrono::steady_clock::now();
+        entries = scanTree(root, checksum);
+        double elapsed = secondsSince(start);
+        best = pass == 0 ? elapsed : std::min(best, elapsed);
+    }
+    std::printf("sizeof(Node) %zu, sizeof(File) %zu\n", sizeof(Node), sizeof(File));
+    std::printf("%-10s %16s %12s %14s\n", "entries", "resident/entry", "scan ms", "scan ns/entry");
+    std::printf("%-10zu %16zu %12.1f %14.1f\n", entries, resident / entries, best * 1e3, best * 1e9 / entries);
+    if (checksum == 0) {
+        std::printf("empty scan\n");
+    }
+}
+
+// Counts a 64 MiB text of short words and lines with TextCounter and with
+// the getline/istringstream loop FileSystem::wc used before it.
+void benchWc() {
+    const std::size_t size = 64 << 20;
+    std::string text;
+    text.reserve(size + 16);
+    std::mt19937 random(1);
+    while (text.size() < size) {
+        std::size_t words = 1 + random() % 12;
+        for (std::size_t w = 0; w < words; ++w) {
+            text.append(1 + random() % 9, static_cast<char>('a' + random() % 26));
+            text += w + 1 == words ? '\n' : random() % 8 == 0 ? '\t' : ' ';
+        }
+    }
+#if defined(__AVX2__)
+    const char* kernel = "AVX2";
+#elif defined(__SSE2__)
+    const char* kernel = "SSE2";
+#else
+    const char* kernel = "scalar";
+#endif
+    double best = 0;
+    TextCounts counts;
+    for (int pass = 0; pass < 3; ++pass) {
+        auto start = std::chrono::steady_clock::now();
+        TextCounter counter;
+        counter.update(text.data(), text.size());
+        double elapsed = secondsSince(start);
+        counts = counter.getCounts();
+        best = pass == 0 ? elapsed : std::min(best, elapsed);
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t lines = 0;
+    std::uint64_t words = 0;
+    std::istringstream in(text);
+    std::string line;
+    std::string word;
+    while (std::getline(in, line)) {
+        ++lines;
+        std::istringstream lineIn(line);
+        while (lineIn >> word) {
+            ++words;
+        }
+    }
+    double old = secondsSince(start);
+    if (lines != counts.lines || words != counts.words) {
+        std::fprintf(stderr, "wc: counts differ (%llu/%llu lines, %llu/%llu words)\n",
+                     static_cast<unsigned long long>(counts.lines), static_cast<unsigned long long>(lines),
+                     static_cast<unsigned long long>(counts.words), static_cast<unsigned long long>(words));
+    }
+    std::printf("%-10s %12s %14s\n", "kernel", "kernel GB/s", "getline GB/s");
+    std::printf("%-10s %12.2f %14.3f\n", kernel, text.size() / best / 1e9, text.size() / old / 1e9);
+}
+
+// Builds a tree of 1000 directories holding files directories each, then
+// frees it, counting the heap allocations made while building.
+void benchBuild() {
+    std::printf("%-10s %10s %12s %14s %10s %14s %14s\n", "entries", "build s", "heap allocs", "allocs/entry",
+                "free s", "slab allocs", "slab mallocs");
+    const std::size_t directories = 1000;
+    for (std::size_t files : {100, 1000}) {
+        std::unique_ptr<FileSystem> fs(new FileSystem);
+        unsigned long long before = heapAllocations;
+        double build;
+        {
+            QuietOutput quiet;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t d = 0; d < directories; ++d) {
+                std::string directory = "d" + std::to_string(d);
+                fs->createDirectory(directory);
+                for (std::size_t f = 0; f < files; ++f) {
+                    fs->createFile("/" + directory + "/f" + std::to_string(f));
+                }
+            }
+            build = secondsSince(start);
+        }
+        unsigned long long allocations = heapAllocations - before;
+        std::size_t entries = directories * (files + 1);
+        const SlabAllocator& allocator = fs->takeSnapshot().tree.getAllocator();
+        unsigned long long slabAllocations = allocator.getAllocations();
+        unsigned long long slabMallocs = allocator.getSystemAllocations();
+        auto start = std::chrono::steady_clock::now();
+        fs.reset();
+        double release = secondsSince(start);
+        std::printf("%-10zu %10.3f %12llu %14.2f %10.3f %14llu %14llu\n", entries, build, allocations,
+                    static_cast<double>(allocations) / entries, release, slabAllocations, slabMallocs);
+    }
+}
+
+// Appends to a file with two hard links in a tree of n other entries; the
+// cost of a write should not depend on n.
+void benchLinks() {
+    std::printf("%-10s %14s\n", "entries", "append us");
+    for (std::size_t n : {1000, 10000, 100000, 1000000}) {
+        FileSystem fs;
+        const std::size_t writes = 2000;
+        double elapsed;
+        {
+            QuietOutput quiet;
+            for (std::size_t d = 0; d < n / 1000; ++d) {
+                std::string directory = "d" + std::to_string(d);
+                fs.createDirectory(directory);
+                for (std::size_t f = 0; f < 1000; ++f) {
+                    fs.createFile("/" + directory + "/f" + std::to_string(f));
+                }
+            }
+            fs.createFile("/log");
+            fs.ln("/log", "/d0/log");
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < writes; ++i) {
+                fs.echoToFile("/log", "line", true);
+            }
+            elapsed = secondsSince(start);
+        }
+        std::printf("%-10zu %14.2f\n", n, elapsed * 1e6 / writes);
+    }
+}
+
+// Looks every name of an n-entry directory up once through the directory
+// index and once by scanning the child list as findChildNode() used to; the
+// index should cost the same per lookup whatever n is.
+void benchLookup() {
+    std::printf("%-10s %14s %14s\n", "entries", "index ns", "scan ns");
+    for (std::size_t n : {10, 100, 1000, 10000, 100000}) {
+        FileSystem fs;
+        std::vector<std::string> names;
+        {
+            QuietOutput quiet;
+            for (std::size_t i = 0; i < n; ++i) {
+                names.push_back("f" + std::to_string(i));
+                fs.createFile(names.back());
+            }
+        }
+        const Node* root = fs.findNode("/");
+        // Enough rounds for about a million index lookups at every size.
+        std::size_t rounds = (1000000 + n - 1) / n;
+        std::size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (const std::string& name : names) {
+                found += root->findChild(name) != nullptr;
+            }
+        }
+        double indexed = secondsSince(start) * 1e9 / (rounds * n);
+        // The scan is quadratic in n; a few thousand lookups are plenty.
+        std::size_t scans = std::min<std::size_t>(n, 2000);
+        start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < scans; ++i) {
+            const std::string& name = names[i * n / scans];
+            for (const Node* child : root->children) {
+                if (child->getName() == name) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        double scanned = secondsSince(start) * 1e9 / scans;
+        if (found != rounds * n + scans) {
+            std::fprintf(stderr, "lookup: missed %zu names\n", rounds * n + scans - found);
+        }
+        std::printf("%-10zu %14.1f %14.1f\n", n, indexed, scanned);
+    }
+}
+
+// Creates n files in one directory, then deletes all of them; both phases
+// should grow linearly with n.
+void benchDelete() {
+    std::printf("%-10s %12s %12s %14s\n", "files", "create s", "delete s", "delete ns/file");
+    for (std::size_t n : {25000, 50000, 100000, 200000}) {
+        FileSystem fs;
+        double create;
+        double remove;
+        {
+            QuietOutput quiet;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < n; ++i) {
+                fs.createFile("f" + std::to_string(i));
+            }
+            create = secondsSince(start);
+            start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < n; ++i) {
+                fs.deleteFile("/f" + std::to_string(i), false, false);
+            }
+            remove = secondsSince(start);
+        }
+        std::printf("%-10zu %12.3f %12.3f %14.0f\n", n, create, remove, remove * 1e9 / n);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const std::map<std::string, std::function<void()>> benchmarks = {
+        {"build", benchBuild},
+        {"delete", benchDelete},
+        {"links", benchLinks},
+        {"lookup", benchLookup},
+        {"scan", benchScan},
+        {"wc", benchWc},
+    };
+    std::vector<std::string> names(argv + 1, argv + argc);
+    if (names.empty()) {
+        for (const auto& benchmark : benchmarks) {
+            names.push_back(benchmark.first);
+        }
+    }
+    for (const std::string& name : names) {
+        auto benchmark = benchmarks.find(name);
+        if (benchmark == benchmarks.end()) {
+            std::cerr << "unknown benchmark: " << name << std::endl;
+            return 1;
+        }
+        std::cout << "== " << name << std::endl;
+        benchmark->second();
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef LINUX_EMULATOR_BOUNDEDQUEUE_H
+#define LINUX_EMULATOR_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace LinuxEmulator {
+
+// Blocking FIFO with a fixed capacity, for handing results from worker
+// threads to the thread that prints them. push() waits while the queue is
+// full, so producers can never run more than capacity items ahead of the
+// consumer; pop() waits for an item and returns false once the queue is
+// closed and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t);
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    bool push(T&&);
+    bool pop(T&);
+    void close();
+private:
+    std::size_t capacity;
+    std::deque<T> items;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(std::size_t size) : capacity{size == 0 ? 1 : size}, closed{false} {}
+
+// Returns false, dropping item, if the queue has been closed.
+template <typename T>
+bool BoundedQueue<T>::push(T&& item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+    if (closed) {
+        return false;
+    }
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+    return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+    if (items.empty()) {
+        return false;
+    }
+    item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+template <typename T>
+void BoundedQueue<T>::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_BOUNDEDQUEUE_H
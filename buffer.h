@@ -0,0 +1,570 @@
+#ifndef LINUX_EMULATOR_BUFFER_H
+#define LINUX_EMULATOR_BUFFER_H
+
+#include "lz.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace LinuxEmulator {
+
+class BlobStore;
+
+// Owning byte buffer for file contents, stored as a list of extents. Extent
+// k holds minExtent << k bytes, so a small file costs one small block, large
+// files need only a logarithmic number of extents, and bytes never move once
+// written: append() is amortized O(appended bytes). The length is stored, so
+// embedded NULs survive and size() is O(1). Readers walk the extents through
+// chunk() or the find/write helpers instead of flattening the content.
+// Line queries go through a newline-offset index that is built on first use
+// and then extended by append(), so finding the last N lines is O(N).
+// The extents form a reference-counted blob: copying a buffer shares it in
+// O(1), and the first modification through a buffer whose blob is shared
+// gives that buffer a private copy. A blob that has not been read for a
+// while can be compressed by its BlobStore; any access through chunk(),
+// back() or write() restores the extents first. A buffer can also be a view
+// of bytes that someone else owns, such as a mapped image; the extents then
+// point into those bytes and any write starts with a private copy.
+class ContentBuffer {
+public:
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+    ContentBuffer();
+    explicit ContentBuffer(std::string_view);
+    ContentBuffer(const char*, std::size_t, std::shared_ptr<const void>);
+    ContentBuffer(const ContentBuffer&);
+    ContentBuffer(ContentBuffer&&) noexcept;
+    ContentBuffer& operator=(const ContentBuffer&);
+    ContentBuffer& operator=(ContentBuffer&&) noexcept;
+    ~ContentBuffer();
+    std::size_t size() const;
+    bool empty() const;
+    std::size_t chunkCount() const;
+    std::string_view chunk(std::size_t) const;
+    char back() const;
+    std::size_t find(char, std::size_t) const;
+    std::size_t rfind(char, std::size_t) const;
+    void write(std::ostream&, std::size_t, std::size_t) const;
+    std::size_t lineCount() const;
+    std::size_t lineStart(std::size_t) const;
+    std::size_t lineEnd(std::size_t) const;
+    void assign(std::string_view);
+    void append(std::string_view);
+    void clear();
+private:
+    friend class BlobStore;
+    // Heap block behind a non-empty buffer, which keeps the buffer itself at
+    // two words. store is set while the blob is registered in a BlobStore
+    // under key. While compressed, the extents are null and packed holds
+    // each extent's LZ stream, ending at the matching packedEnds offset.
+    // owner is set when the extents are borrowed from a contiguous range.
+    struct Storage {
+        std::vector<char*> extents;
+        std::vector<std::uint64_t> newlines;
+        bool indexed;
+        std::uint32_t references;
+        BlobStore* store;
+        std::uint64_t key;
+        std::int64_t lastAccess;
+        std::vector<char> packed;
+        std::vector<std::uint32_t> packedEnds;
+        std::shared_ptr<const void> owner;
+    };
+    static const std::size_t minExtent = 64;
+    static std::size_t extentCapacity(std::size_t);
+    static std::size_t extentStart(std::size_t);
+    static std::size_t extentOf(std::size_t);
+    void indexNewlines(std::size_t, std::size_t) const;
+    static bool isPacked(const Storage*);
+    static std::uint64_t packingSavings(const Storage*);
+    static bool pack(Storage*, std::uint64_t);
+    static void unpack(Storage*, std::uint64_t);
+    void access() const;
+    void retain();
+    void unshare();
+    Storage* storage;
+    std::uint64_t length;
+};
+
+// Content-addressed index over the blobs of one tree and its snapshots.
+// intern() points a buffer at an already stored blob with the same bytes, or
+// registers the buffer's blob under its content hash, so equal contents are
+// kept once no matter how they were written. A blob leaves the index when its
+// last reference goes away or when it is modified in place.
+class BlobStore {
+public:
+    BlobStore();
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+    ~BlobStore();
+    void intern(ContentBuffer&, std::uint64_t);
+    std::size_t compressIdle(std::int64_t, std::int64_t);
+    std::size_t size() const;
+    std::uint64_t getStoredBytes() const;
+    std::uint64_t getReferencedBytes() const;
+    std::size_t getCompressedCount() const;
+    std::uint64_t getCompressionSavings() const;
+    unsigned long long getCompressions() const;
+    unsigned long long getDecompressions() const;
+private:
+    friend class ContentBuffer;
+    struct Blob {
+        ContentBuffer::Storage* storage;
+        std::uint64_t length;
+    };
+    static bool sameBytes(const Blob&, const ContentBuffer&);
+    void forget(ContentBuffer::Storage*);
+    std::unordered_multimap<std::uint64_t, Blob> blobs;
+    std::uint64_t storedBytes;
+    std::uint64_t referencedBytes;
+    std::size_t compressedCount;
+    std::uint64_t compressionSavings;
+    unsigned long long compressions;
+    unsigned long long decompressions;
+};
+
+ContentBuffer::ContentBuffer() : storage{nullptr}, length{0} {}
+
+ContentBuffer::ContentBuffer(std::string_view content) : storage{nullptr}, length{0} {
+    append(content);
+}
+
+// Extent k of a buffer always starts at extentStart(k), so the extents of a
+// contiguous range are just pointers into it.
+ContentBuffer::ContentBuffer(const char* bytes, std::size_t size, std::shared_ptr<const void> owner) 
+    : storage{nullptr}, length{size} {
+    if (size == 0) {
+        return;
+    }
+    storage = new Storage{{}, {}, false, 1, nullptr, 0, std::time(nullptr), {}, {}, std::move(owner)};
+    for (std::size_t index = 0; index < chunkCount(); ++index) {
+        storage->extents.push_back(const_cast<char*>(bytes + extentStart(index)));
+    }
+}
+
+ContentBuffer::ContentBuffer(const ContentBuffer& other) : storage{other.storage}, length{other.length} {
+    retain();
+}
+
+ContentBuffer::ContentBuffer(ContentBuffer&& other) noexcept : storage{other.storage}, length{other.length} {
+    other.storage = nullptr;
+    other.length = 0;
+}
+
+ContentBuffer& ContentBuffer::operator=(const ContentBuffer& other) {
+    if (this != &other) {
+        ContentBuffer copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+ContentBuffer& ContentBuffer::operator=(ContentBuffer&& other) noexcept {
+    std::swap(storage, other.storage);
+    std::swap(length, other.length);
+    return *this;
+}
+
+ContentBuffer::~ContentBuffer() {
+    clear();
+}
+
+std::size_t ContentBuffer::extentCapacity(std::size_t index) {
+    return minExtent << index;
+}
+
+std::size_t ContentBuffer::extentStart(std::size_t index) {
+    return minExtent * ((static_cast<std::size_t>(1) << index) - 1);
+}
+
+std::size_t ContentBuffer::extentOf(std::size_t offset) {
+    std::size_t index = 0;
+    while (extentStart(index + 1) <= offset) {
+        ++index;
+    }
+    return index;
+}
+
+std::size_t ContentBuffer::size() const {
+    return length;
+}
+
+bool ContentBuffer::empty() const {
+    return length == 0;
+}
+
+// Only the extents that hold data are allocated.
+std::size_t ContentBuffer::chunkCount() const {
+    return length == 0 ? 0 : extentOf(length - 1) + 1;
+}
+
+std::string_view ContentBuffer::chunk(std::size_t index) const {
+    access();
+    std::size_t start = extentStart(index);
+    std::size_t used = length - start < extentCapacity(index) ? length - start : extentCapacity(index);
+    return std::string_view(storage->extents[index], used);
+}
+
+char ContentBuffer::back() const {
+    access();
+    std::size_t index = extentOf(length - 1);
+    return storage->extents[index][length - 1 - extentStart(index)];
+}
+
+std::size_t ContentBuffer::find(char c, std::size_t from) const {
+    for (std::size_t index = from < length ? extentOf(from) : chunkCount(); index < chunkCount(); ++index) {
+        std::size_t start = extentStart(index);
+        std::string_view bytes = chunk(index);
+        std::size_t found = bytes.find(c, from > start ? from - start : 0);
+        if (found != std::string_view::npos) {
+            return start + found;
+        }
+    }
+    return npos;
+}
+
+// Last occurrence of c at or before position from.
+std::size_t ContentBuffer::rfind(char c, std::size_t from) const {
+    if (length == 0) {
+        return npos;
+    }
+    if (from >= length) {
+        from = length - 1;
+    }
+    for (std::size_t index = extentOf(from) + 1; index-- > 0;) {
+        std::size_t start = extentStart(index);
+        std::size_t found = chunk(index).rfind(c, from - start < extentCapacity(index) ? from - start : npos);
+        if (found != std::string_view::npos) {
+            return start + found;
+        }
+    }
+    return npos;
+}
+
+// Writes the bytes in [begin, end) chunk by chunk.
+void ContentBuffer::write(std::ostream& out, std::size_t begin, std::size_t end) const {
+    if (end > length) {
+        end = length;
+    }
+    if (begin < end) {
+        access();
+    }
+    while (begin < end) {
+        std::size_t index = extentOf(begin);
+        std::size_t offset = begin - extentStart(index);
+        std::size_t count = extentCapacity(index) - offset;
+        if (count > end - begin) {
+            count = end - begin;
+        }
+        out.write(storage->extents[index] + offset, static_cast<std::streamsize>(count));
+        begin += count;
+    }
+}
+
+// Records the newlines in [begin, end) once the index exists.
+void ContentBuffer::indexNewlines(std::size_t begin, std::size_t end) const {
+    for (std::size_t found = find('\n', begin); found < end; found = find('\n', found + 1)) {
+        storage->newlines.push_back(found);
+    }
+}
+
+// A final line without a trailing newline still counts.
+std::size_t ContentBuffer::lineCount() const {
+    if (length == 0) {
+        return 0;
+    }
+    if (!storage->indexed) {
+        indexNewlines(0, length);
+        storage->indexed = true;
+    }
+    return storage->newlines.size() + (back() == '\n' ? 0 : 1);
+}
+
+// Line boundaries for line numbers below lineCount(); the end excludes the
+// newline.
+std::size_t ContentBuffer::lineStart(std::size_t line) const {
+    return line == 0 ? 0 : storage->newlines[line - 1] + 1;
+}
+
+std::size_t ContentBuffer::lineEnd(std::size_t line) const {
+    return line < storage->newlines.size() ? storage->newlines[line] : length;
+}
+
+void ContentBuffer::assign(std::string_view content) {
+    clear();
+    append(content);
+}
+
+bool ContentBuffer::isPacked(const Storage* blob) {
+    return !blob->packedEnds.empty();
+}
+
+// Extent bytes given back by packing, less what the packed form takes.
+std::uint64_t ContentBuffer::packingSavings(const Storage* blob) {
+    std::uint64_t packedBytes = blob->packed.size() + blob->packedEnds.size() * sizeof(std::uint32_t);
+    std::uint64_t extentBytes = extentStart(blob->extents.size());
+    return extentBytes > packedBytes ? extentBytes - packedBytes : 0;
+}
+
+// Compresses the extents of a blob holding length bytes and frees them.
+// Returns false, leaving the blob as it was, if that would not save memory.
+bool ContentBuffer::pack(Storage* blob, std::uint64_t length) {
+    std::vector<char> packed;
+    std::vector<std::uint32_t> packedEnds;
+    for (std::size_t index = 0; index < blob->extents.size(); ++index) {
+        std::size_t start = extentStart(index);
+        std::size_t used = length - start < extentCapacity(index) ? length - start : extentCapacity(index);
+        lz::compress(blob->extents[index], used, packed);
+        packedEnds.push_back(static_cast<std::uint32_t>(packed.size()));
+    }
+    if (packed.size() + packedEnds.size() * sizeof(std::uint32_t) >= length) {
+        return false;
+    }
+    for (char*& extent : blob->extents) {
+        delete[] extent;
+        extent = nullptr;
+    }
+    blob->packed = std::move(packed);
+    blob->packed.shrink_to_fit();
+    blob->packedEnds = std::move(packedEnds);
+    // The line index is rebuilt on demand.
+    std::vector<std::uint64_t>().swap(blob->newlines);
+    blob->indexed = false;
+    return true;
+}
+
+void ContentBuffer::unpack(Storage* blob, std::uint64_t length) {
+    if (blob->store != nullptr) {
+        --blob->store->compressedCount;
+        blob->store->compressionSavings -= packingSavings(blob);
+        ++blob->store->decompressions;
+    }
+    std::size_t begin = 0;
+    for (std::size_t index = 0; index < blob->extents.size(); ++index) {
+        std::size_t start = extentStart(index);
+        std::size_t used = length - start < extentCapacity(index) ? length - start : extentCapacity(index);
+        blob->extents[index] = new char[extentCapacity(index)];
+        lz::decompress(blob->packed.data() + begin, blob->packedEnds[index] - begin, blob->extents[index], used);
+        begin = blob->packedEnds[index];
+    }
+    std::vector<char>().swap(blob->packed);
+    std::vector<std::uint32_t>().swap(blob->packedEnds);
+}
+
+// Every read of the bytes goes through here: it stamps the access time the
+// store uses to find cold blobs and unpacks a compressed blob.
+void ContentBuffer::access() const {
+    if (storage == nullptr) {
+        return;
+    }
+    storage->lastAccess = std::time(nullptr);
+    if (isPacked(storage)) {
+        unpack(storage, length);
+    }
+}
+
+void ContentBuffer::retain() {
+    if (storage == nullptr) {
+        return;
+    }
+    ++storage->references;
+    if (storage->store != nullptr) {
+        storage->store->referencedBytes += length;
+    }
+}
+
+// Makes the blob private to this buffer and takes it out of the store, as it
+// is about to change. Borrowed bytes are never written in place.
+void ContentBuffer::unshare() {
+    access();
+    if (storage->references > 1 || storage->owner != nullptr) {
+        ContentBuffer copy;
+        for (std::size_t i = 0; i < chunkCount(); ++i) {
+            copy.append(chunk(i));
+        }
+        *this = std::move(copy);
+    } else if (storage->store != nullptr) {
+        storage->store->forget(storage);
+    }
+}
+
+void ContentBuffer::append(std::string_view content) {
+    if (content.empty()) {
+        return;
+    }
+    if (storage == nullptr) {
+        storage = new Storage{{}, {}, false, 1, nullptr, 0, std::time(nullptr), {}, {}, nullptr};
+    } else {
+        unshare();
+    }
+    std::size_t oldLength = length;
+    std::size_t position = 0;
+    while (position < content.size()) {
+        std::size_t index = extentOf(length);
+        if (index == storage->extents.size()) {
+            storage->extents.push_back(new char[extentCapacity(index)]);
+        }
+        std::size_t offset = length - extentStart(index);
+        std::size_t count = extentCapacity(index) - offset;
+        if (count > content.size() - position) {
+            count = content.size() - position;
+        }
+        std::memcpy(storage->extents[index] + offset, content.data() + position, count);
+        position += count;
+        length += count;
+    }
+    if (storage->indexed) {
+        indexNewlines(oldLength, length);
+    }
+}
+
+// Drops this buffer's reference; the blob is freed with the last one.
+void ContentBuffer::clear() {
+    if (storage != nullptr && storage->store != nullptr) {
+        storage->store->referencedBytes -= length;
+    }
+    if (storage != nullptr && --storage->references == 0) {
+        if (storage->store != nullptr) {
+            storage->store->forget(storage);
+        }
+        if (storage->owner == nullptr) {
+            for (char* extent : storage->extents) {
+                delete[] extent;
+            }
+        }
+        delete storage;
+    }
+    storage = nullptr;
+    length = 0;
+}
+
+BlobStore::BlobStore() 
+    : storedBytes{0}, referencedBytes{0}, compressedCount{0}, compressionSavings{0}, compressions{0}, decompressions{0} {}
+
+// Buffers may outlive the tree that interned them; they keep their blobs but
+// stop reporting to the store.
+BlobStore::~BlobStore() {
+    for (auto& entry : blobs) {
+        entry.second.storage->store = nullptr;
+    }
+}
+
+// Equal lengths mean equal extent layouts, so the extents compare pairwise.
+bool BlobStore::sameBytes(const Blob& blob, const ContentBuffer& buffer) {
+    if (blob.length != buffer.length) {
+        return false;
+    }
+    if (ContentBuffer::isPacked(blob.storage)) {
+        ContentBuffer::unpack(blob.storage, blob.length);
+    }
+    for (std::size_t i = 0; i < buffer.chunkCount(); ++i) {
+        std::string_view bytes = buffer.chunk(i);
+        if (std::memcmp(blob.storage->extents[i], bytes.data(), bytes.size()) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// hash must be the hash of the buffer's bytes.
+void BlobStore::intern(ContentBuffer& buffer, std::uint64_t hash) {
+    ContentBuffer::Storage* storage = buffer.storage;
+    if (storage == nullptr || storage->store != nullptr) {
+        return;
+    }
+    auto range = blobs.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.storage != storage && sameBytes(it->second, buffer)) {
+            ContentBuffer shared;
+            shared.storage = it->second.storage;
+            shared.length = buffer.length;
+            shared.retain();
+            buffer = std::move(shared);
+            return;
+        }
+    }
+    storage->store = this;
+    storage->key = hash;
+    blobs.emplace(hash, Blob{storage, buffer.length});
+    storedBytes += buffer.length;
+    referencedBytes += buffer.length * storage->references;
+}
+
+void BlobStore::forget(ContentBuffer::Storage* storage) {
+    auto range = blobs.equal_range(storage->key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.storage == storage) {
+            if (ContentBuffer::isPacked(storage)) {
+                --compressedCount;
+                compressionSavings -= ContentBuffer::packingSavings(storage);
+            }
+            storedBytes -= it->second.length;
+            referencedBytes -= it->second.length * storage->references;
+            blobs.erase(it);
+            break;
+        }
+    }
+    storage->store = nullptr;
+}
+
+// Compresses the blobs last read more than idleSeconds before now. Blobs of a
+// couple of extents or less are not worth it. Returns how many were packed.
+std::size_t BlobStore::compressIdle(std::int64_t now, std::int64_t idleSeconds) {
+    std::size_t packed = 0;
+    for (auto& entry : blobs) {
+        ContentBuffer::Storage* storage = entry.second.storage;
+        // Borrowed bytes are backed by their owner, e.g. a file the kernel can page out.
+        if (ContentBuffer::isPacked(storage) || storage->owner != nullptr || storage->extents.size() < 2 || 
+            now - storage->lastAccess < idleSeconds) {
+            continue;
+        }
+        if (ContentBuffer::pack(storage, entry.second.length)) {
+            ++compressedCount;
+            compressionSavings += ContentBuffer::packingSavings(storage);
+            ++compressions;
+            ++packed;
+        }
+    }
+    return packed;
+}
+
+std::size_t BlobStore::size() const {
+    return blobs.size();
+}
+
+std::uint64_t BlobStore::getStoredBytes() const {
+    return storedBytes;
+}
+
+// Bytes as seen through every reference, i.e. what the contents would take
+// without sharing.
+std::uint64_t BlobStore::getReferencedBytes() const {
+    return referencedBytes;
+}
+
+std::size_t BlobStore::getCompressedCount() const {
+    return compressedCount;
+}
+
+std::uint64_t BlobStore::getCompressionSavings() const {
+    return compressionSavings;
+}
+
+unsigned long long BlobStore::getCompressions() const {
+    return compressions;
+}
+
+unsigned long long BlobStore::getDecompressions() const {
+    return decompressions;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_BUFFER_H
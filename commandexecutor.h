@@ -1,192 +1,716 @@
-#ifndef LINUX_EMULATOR_COMMANDEXECUTOR_H
-#define LINUX_EMULATOR_COMMANDEXECUTOR_H
-
-#include "commandvalidator.h"
-#include "filesystem.h"
-#include "user.h"
-#include "anothercommands.h"
-
-namespace LinuxEmulator {
-
-class CommandExecutor {
-public:
-	CommandExecutor();
-	CommandExecutor(const Command&);
-	CommandExecutor(const FileSystem&);
-    	CommandExecutor(const User&);
-    	CommandExecutor(const FileSystem&, const User&);
-	void execute(const Command&);
-private:
-	Command command;
-	FileSystem fs;
-    	User u;
-};
-
-CommandExecutor::CommandExecutor() = default;
-
-CommandExecutor::CommandExecutor(const Command& c) : command{c} {}
-
-CommandExecutor::CommandExecutor(const FileSystem& f) : fs{f} {}
-
-CommandExecutor::CommandExecutor(const User& us) : u{us} {}
-
-CommandExecutor::CommandExecutor(const FileSystem& f, const User& us) : fs{f}, u{us} {}
-
-void CommandExecutor::execute(const Command& com) {
-	CommandValidator validator;
-    	AnotherCommands a;
-	if (!validator.isValidCommand(com)) {
-        	std::cout << com.getName() << ": command not found" << std::endl;
-        	return;
-    	}
-    	if (com.getName() == "mkdir") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	for (const std::string& arg : arguments) {
-            		fs.createDirectory(arg);
-        	}
-    	} else if(com.getName() == "date") {
-        	a.date();
-    	} else if(com.getName() == "cal") {
-        	a.cal();
-    	} else if(com.getName() == "df") {
-        	a.df();
-    	} else if(com.getName() == "free") {
-        	a.free();
-    	} else if(com.getName() == "help") {
-        	fs.help();
-    	} else if (com.getName() == "cd") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	if (arguments.empty()) {
-            		fs.cd("/");
-        	} else {
-            		fs.cd(arguments[0]);
-        	}
-    	} else if (com.getName() == "pwd") {
-        	fs.pwd();
-    	} else if (com.getName() == "ls") {
-        	const std::map<std::string, std::vector<std::string>>& options = com.getOptions();
-        	auto isOptionPresent = [&options](const std::string& option) {
-            		for (const auto& optionPair : options) {
-                		if (optionPair.first == option) {
-                    			return true;
-                		}
-            		}
-            		return false;
-        	};
-        
-        	if (isOptionPresent("-la")) {
-            		fs.lsDetailed();
-        	}
-        	else if (isOptionPresent("-lt")) {
-            		fs.lsSortedByTime();
-        	}
-        	else if (isOptionPresent("-l")) {
-            		fs.lsDetailed();
-        	}
-        	else {
-            		fs.ls();
-        	}
-    	} else if (com.getName() == "cat" || com.getName() == "less") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	for (const std::string& arg : arguments) {
-            		fs.readFile(arg);
-        }
-    	} else if (com.getName() == "touch") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	for (const std::string& arg : arguments) {
-            		fs.createFile(arg);
-        	}
-    	} else if (com.getName() == "vim") {
-    		std::vector<std::string> arguments = com.getArguments();
-    		fs.createFile(arguments[0]);
-    		fs.writeFile(arguments[0]);
-    	} else if (com.getName() == "rmdir") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	for (const std::string& arg : arguments) {
-            		fs.deleteFile(arg);
-        	}
-    	} else if (com.getName() == "rm") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	for (const std::string& arg : arguments) {
-            		fs.deleteFile(arg);
-        	}
-    	} else if (com.getName() == "mv") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	std::string destination = arguments.back();
-        	std::vector<std::string> sources(arguments.begin(), arguments.end() - 1);
-        	for (int i = 0; i < sources.size(); ++i) {
-        		fs.moveFile(sources[i], destination);
-        	}
-    	} else if (com.getName() == "cp") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	std::string destination = arguments.back();
-        	std::vector<std::string> sources(arguments.begin(), arguments.end() - 1);
-        	for (int i = 0; i < sources.size(); ++i) {
-			fs.copyFile(sources[i], destination);        
-		}
-    	} else if (com.getName() == "chmod") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	fs.chmod(arguments[0], arguments[1]);
-    	} else if (com.getName() == "useradd") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	if (arguments.size() >= 1) {
-            		u.useradd(arguments[0]);
-        	}
-        	else {
-            		std::cout << "Invalid arguments for command useradd" << std::endl;
-        	}
-    	} else if (com.getName() == "passwd") {
-        	u.passwd();
-    	} else if (com.getName() == "history") {
-        	fs.history();
-    	} else if (com.getName() == "clear") {
-        	fs.clear();
-    	} else if (com.getName() == "echo") {
-        	std::vector<std::string> text = com.getArguments();
-        	for (int i = 0 ; i < text.size(); ++i) {
-            		a.echo(text[i]);
-        	} 
-        	std::cout << std::endl;
-    	} else if (com.getName() == "id") {
-        	u.id();
-    	} else if (com.getName() == "head") {
-        	if (com.getArguments().size() >= 2) {
-            		std::string fileName = com.getArguments().at(1);
-            		int numLines = std::stoi(com.getArguments().at(0));  
-            		fs.head(numLines, fileName);
-        	} else {
-            		std::cout << "Invalid arguments for 'head' command." << std::endl;
-        	}
-    	} else if (com.getName() == "tail") {
-        	if (com.getArguments().size() >= 2) {
-            		std::string fileName = com.getArguments().at(1);
-            		int numLines = std::stoi(com.getArguments().at(0));  
-            		fs.tail(numLines, fileName);
-        	} else {
-            		std::cout << "Invalid arguments for 'tail' command." << std::endl;
-        	}
-    	} else if (com.getName() == "file") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	fs.file(arguments[0]);
-    	} else if (com.getName() == "wc") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	fs.wc(arguments[0]);
-    	} else if (com.getName() == "ln" || com.getName() == "ln -s") {
-        	fs.ln(com.getArguments().at(0), com.getArguments().at(1));
-    	} else if (com.getName() == "ps") {
-        	a.ps();
-    	} else if (com.getName() == "top") {
-        	a.top();
-    	} else if (com.getName() == "jobs") {
-        	a.jobs();
-    	} else if (com.getName() == "whatis") {
-        	std::vector<std::string> arguments = com.getArguments();
-        	a.whatis(arguments[0]);
-    	} else {
-        	std::cout << "Unknown command: " << com.getName() << std::endl;
-    	}
-}
-
-} // namespace LinuxEmulator
-
-#endif // LINUX_EMULATOR_COMMANDEXECUTOR_H
+#ifndef LINUX_EMULATOR_COMMANDEXECUTOR_H
+#define LINUX_EMULATOR_COMMANDEXECUTOR_H
+
+#include "commandvalidator.h"
+#include "filesystem.h"
+#include "user.h"
+#include "anothercommands.h"
+#include "journal.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+namespace LinuxEmulator {
+
+class CommandExecutor {
+public:
+	CommandExecutor();
+	CommandExecutor(const Command&);
+	CommandExecutor(const FileSystem&);
+    	CommandExecutor(const User&);
+    	CommandExecutor(const FileSystem&, const User&);
+	void execute(const Command&);
+	FileSystem& getFileSystem();
+private:
+	static bool isJournaled(const Command&);
+	void journalCommand(const std::vector<std::string>&);
+	void openJournal(const std::string&);
+	void checkpoint();
+	Command command;
+	FileSystem fs;
+    	User u;
+    	std::shared_ptr<Journal> journal;
+    	unsigned long checkpointInterval = 1000;
+    	bool replaying = false;
+};
+
+CommandExecutor::CommandExecutor() = default;
+
+CommandExecutor::CommandExecutor(const Command& c) : command{c} {}
+
+CommandExecutor::CommandExecutor(const FileSystem& f) : fs{f} {}
+
+CommandExecutor::CommandExecutor(const User& us) : u{us} {}
+
+CommandExecutor::CommandExecutor(const FileSystem& f, const User& us) : fs{f}, u{us} {}
+
+FileSystem& CommandExecutor::getFileSystem() {
+	return fs;
+}
+
+void CommandExecutor::execute(const Command& com) {
+	CommandValidator validator;
+    	AnotherCommands a;
+	if (!validator.isValidCommand(com)) {
+        	std::cout << com.getName() << ": command not found" << std::endl;
+        	return;
+    	}
+    	// Deleted subtrees are only reclaimed in the background between commands.
+    	StorageLock storageLock = fs.lockStorage();
+    	// Relative paths in a journaled command are replayed from here.
+    	std::string directory = fs.getCurrentDirectory();
+    	std::string written;
+    	if (com.getName() == "mkdir") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	for (const std::string& arg : arguments) {
+            		fs.createDirectory(arg);
+        	}
+    	} else if(com.getName() == "date") {
+        	a.date();
+    	} else if(com.getName() == "cal") {
+        	a.cal();
+    	} else if(com.getName() == "df") {
+        	// "df [-h] [-i]" or "df --capacity <size>[K|M|G|T]"
+        	std::map<std::string, std::vector<std::string>> options = com.getOptions();
+        	auto capacity = options.find("--capacity");
+        	if (capacity == options.end()) {
+            		std::string flags;
+            		for (const auto& option : options) {
+                		flags += option.first;
+            		}
+            		fs.df(flags.find('h') != std::string::npos, flags.find('i') != std::string::npos);
+        	} else {
+            		std::string size = capacity->second.empty() ? "" : capacity->second[0];
+            		std::size_t digits = size.find_first_not_of("0123456789");
+            		std::string units = "KMGT";
+            		std::size_t unit = digits == std::string::npos ? std::string::npos : units.find(size[digits]);
+            		if (digits == 0 || size.empty() || (digits != std::string::npos && (unit == std::string::npos || digits + 1 != size.size()))) {
+                		std::cout << "Invalid arguments for 'df' command." << std::endl;
+            		} else {
+                		fs.setCapacity(std::stoull(size.substr(0, digits)) << (unit == std::string::npos ? 0 : 10 * (unit + 1)));
+            		}
+        	}
+    	} else if(com.getName() == "free") {
+        	a.free();
+    	} else if(com.getName() == "help") {
+        	fs.help();
+    	} else if (com.getName() == "cd") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	if (arguments.empty()) {
+            		fs.cd("/");
+        	} else {
+            		fs.cd(arguments[0]);
+        	}
+    	} else if (com.getName() == "pwd") {
+        	fs.pwd();
+    	} else if (com.getName() == "ls") {
+        	const std::map<std::string, std::vector<std::string>>& options = com.getOptions();
+        	auto isOptionPresent = [&options](const std::string& option) {
+            		for (const auto& optionPair : options) {
+                		if (optionPair.first == option) {
+                    			return true;
+                		}
+            		}
+            		return false;
+        	};
+        
+        	if (isOptionPresent("-la")) {
+            		fs.lsDetailed();
+        	}
+        	else if (isOptionPresent("-lt")) {
+            		fs.lsSortedByTime();
+        	}
+        	else if (isOptionPresent("-l")) {
+            		fs.lsLongFormat();
+        	}
+        	else {
+            		fs.ls();
+        	}
+    	} else if (com.getName() == "cat" || com.getName() == "less") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	for (const std::string& arg : arguments) {
+            		fs.readFile(arg);
+        }
+    	} else if (com.getName() == "touch") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	for (const std::string& arg : arguments) {
+            		fs.createFile(arg);
+        	}
+    	} else if (com.getName() == "vim") {
+    		std::vector<std::string> arguments = com.getArguments();
+    		fs.createFile(arguments[0]);
+    		written = fs.writeFile(arguments[0]);
+    	} else if (com.getName() == "rmdir") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	for (const std::string& arg : arguments) {
+            		fs.removeDirectory(arg);
+        	}
+    	} else if (com.getName() == "rm") {
+        	// "rm [-r|-R] [-f] <path>..."; the options would take the paths as
+        	// their values, so read the raw line.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> paths;
+        	bool recursive = false;
+        	bool force = false;
+        	for (std::size_t i = 1; i < words.size(); ++i) {
+            		if (words[i].size() > 1 && words[i][0] == '-') {
+                		recursive = recursive || words[i].find_first_of("rR") != std::string::npos;
+                		force = force || words[i].find('f') != std::string::npos;
+            		} else {
+                		paths.push_back(words[i]);
+            		}
+        	}
+        	for (const std::string& path : paths) {
+            		fs.deleteFile(path, recursive, force);
+        	}
+    	} else if (com.getName() == "mv") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	std::string destination = arguments.back();
+        	std::vector<std::string> sources(arguments.begin(), arguments.end() - 1);
+        	for (int i = 0; i < sources.size(); ++i) {
+        		fs.moveFile(sources[i], destination);
+        	}
+    	} else if (com.getName() == "cp") {
+        	// "cp [-r|-R|-a] <source>... <destination>"; the options take the
+        	// paths that follow them as their values, so read the raw line.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> paths;
+        	bool recursive = false;
+        	bool preserve = false;
+        	for (std::size_t i = 1; i < words.size(); ++i) {
+            		if (words[i].size() > 1 && words[i][0] == '-') {
+                		recursive = recursive || words[i].find_first_of("rRa") != std::string::npos;
+                		preserve = preserve || words[i].find('a') != std::string::npos;
+            		} else {
+                		paths.push_back(words[i]);
+            		}
+        	}
+        	if (paths.size() < 2) {
+            		std::cout << "Usage: cp [-r|-a] <source>... <destination>" << std::endl;
+        	}
+        	for (std::size_t i = 0; i + 1 < paths.size(); ++i) {
+			fs.copyFile(paths[i], paths.back(), recursive, preserve);
+		}
+    	} else if (com.getName() == "chmod") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	fs.chmod(arguments[0], arguments[1]);
+    	} else if (com.getName() == "useradd") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	if (arguments.size() >= 1) {
+            		u.useradd(arguments[0]);
+        	}
+        	else {
+            		std::cout << "Invalid arguments for command useradd" << std::endl;
+        	}
+    	} else if (com.getName() == "passwd") {
+        	u.passwd();
+    	} else if (com.getName() == "history") {
+        	fs.history();
+    	} else if (com.getName() == "clear") {
+        	fs.clear();
+    	} else if (com.getName() == "echo") {
+        	std::vector<std::string> text = com.getArguments();
+        	auto redirect = std::find_if(text.begin(), text.end(), [](const std::string& t) { return t == ">" || t == ">>"; });
+        	if (redirect != text.end() && redirect + 1 != text.end()) {
+            		std::string line;
+            		for (auto it = text.begin(); it != redirect; ++it) {
+                		line += (it == text.begin() ? "" : " ") + *it;
+            		}
+            		fs.echoToFile(*(redirect + 1), line + "\n", *redirect == ">>");
+        	} else {
+            		for (int i = 0 ; i < text.size(); ++i) {
+                		a.echo(text[i]);
+            		} 
+            		std::cout << std::endl;
+        	}
+    	} else if (com.getName() == "id") {
+        	u.id();
+    	} else if (com.getName() == "head" || com.getName() == "tail") {
+        	// "head N file", "head -n N file" or "head -c N file"; tail likewise.
+        	std::map<std::string, std::vector<std::string>> options = com.getOptions();
+        	bool bytes = options.count("-c") != 0;
+        	std::vector<std::string> operands = options[bytes ? "-c" : "-n"];
+        	std::vector<std::string> arguments = com.getArguments();
+        	operands.insert(operands.end(), arguments.begin(), arguments.end());
+        	if (operands.size() >= 2) {
+            		std::string fileName = operands.at(1);
+            		int count = std::max(std::stoi(operands.at(0)), 0);
+            		if (com.getName() == "head" && bytes) {
+                		fs.headBytes(count, fileName);
+            		} else if (com.getName() == "head") {
+                		fs.head(count, fileName);
+            		} else if (bytes) {
+                		fs.tailBytes(count, fileName);
+            		} else {
+                		fs.tail(count, fileName);
+            		}
+        	} else {
+            		std::cout << "Invalid arguments for '" << com.getName() << "' command." << std::endl;
+        	}
+    	} else if (com.getName() == "file") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	fs.file(arguments[0]);
+    	} else if (com.getName() == "wc") {
+        	// Option parsing hands the file names after "-l" etc. to the option.
+        	std::vector<std::string> fileNames = com.getArguments();
+        	std::map<std::string, std::vector<std::string>> options = com.getOptions();
+        	for (const auto& option : options) {
+            		fileNames.insert(fileNames.end(), option.second.begin(), option.second.end());
+        	}
+        	if (fileNames.empty()) {
+            		std::cout << "Invalid arguments for 'wc' command." << std::endl;
+        	} else if (options.empty()) {
+            		fs.wc(fileNames, true, true, true);
+        	} else {
+            		fs.wc(fileNames, options.count("-l") != 0, options.count("-w") != 0, options.count("-c") != 0);
+        	}
+    	} else if (com.getName() == "grep") {
+        	// Option values are parsed from the raw line, since a pattern or
+        	// a relative path after "-n" would otherwise be taken as its value.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	std::vector<std::string> operands;
+        	Grep::Options options;
+        	bool recursive = false;
+        	bool valid = true;
+        	for (std::size_t i = 1; i < words.size(); ++i) {
+            		if (words[i].empty()) {
+                		continue;
+            		}
+            		if (operands.empty() && words[i].size() > 1 && words[i][0] == '-') {
+                		for (std::size_t j = 1; j < words[i].size(); ++j) {
+                    			switch (words[i][j]) {
+                    			case 'r': recursive = true; break;
+                    			case 'i': options.ignoreCase = true; break;
+                    			case 'n': options.lineNumbers = true; break;
+                    			case 'c': options.countOnly = true; break;
+                    			case 'l': options.filesOnly = true; break;
+                    			case 'E': options.extended = true; break;
+                    			case 'F': options.fixed = true; break;
+                    			default: valid = false;
+                    			}
+                		}
+            		} else if (operands.empty() && (words[i][0] == '"' || words[i][0] == '\'')) {
+                		// A quoted pattern may contain spaces.
+                		std::string pattern = words[i].substr(1);
+                		char quote = words[i][0];
+                		while (pattern.empty() || pattern.back() != quote) {
+                    			if (++i >= words.size()) {
+                        			valid = false;
+                        			break;
+                    			}
+                    			pattern += " " + words[i];
+                		}
+                		pattern.pop_back();
+                		operands.push_back(pattern);
+            		} else {
+                		operands.push_back(words[i]);
+            		}
+        	}
+        	if (recursive && operands.size() == 1) {
+            		operands.push_back(fs.getCurrentDirectory());
+        	}
+        	if (!valid || operands.size() < 2) {
+            		std::cout << "Usage: grep [-rinclEF] <pattern> <file>..." << std::endl;
+        	} else {
+            		fs.grep(operands[0], std::vector<std::string>(operands.begin() + 1, operands.end()), recursive, options);
+        	}
+    	} else if (com.getName() == "sort") {
+        	// "sort [-nru] [-k <field>[,<field>]] [-o <file>] [-S <size>[K|M|G]] <file>...", parsed from
+        	// the raw line like grep.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> fileNames;
+        	TextSort::Options options;
+        	std::string output;
+        	bool valid = true;
+        	for (std::size_t i = 1; i < words.size() && valid; ++i) {
+            		if (words[i].size() < 2 || words[i][0] != '-') {
+                		fileNames.push_back(words[i]);
+                		continue;
+            		}
+            		std::string flags = words[i];
+            		for (std::size_t j = 1; j < flags.size() && valid; ++j) {
+                		if (flags[j] == 'n' || flags[j] == 'r' || flags[j] == 'u') {
+                    			options.numeric = options.numeric || flags[j] == 'n';
+                    			options.reverse = options.reverse || flags[j] == 'r';
+                    			options.unique = options.unique || flags[j] == 'u';
+                    			continue;
+                		}
+                		// -k, -o and -S take the rest of the word or the next one.
+                		std::string value = j + 1 < flags.size() ? flags.substr(j + 1) : i + 1 < words.size() ? words[++i] : "";
+                		std::size_t digits = value.find_first_not_of("0123456789");
+                		if (flags[j] == 'k') {
+                    			std::size_t comma = value.find(',');
+                    			std::string last = comma == std::string::npos ? "1" : value.substr(comma + 1);
+                    			valid = !value.empty() && digits != 0 && digits == comma && !last.empty() && last.find_first_not_of("0123456789") == std::string::npos;
+                    			options.keyStart = valid ? std::stoi(value.substr(0, comma)) : 0;
+                    			options.keyEnd = valid && comma != std::string::npos ? std::stoi(last) : 0;
+                    			valid = valid && options.keyStart > 0 && (comma == std::string::npos || options.keyEnd > 0);
+                		} else if (flags[j] == 'o') {
+                    			output = value;
+                    			valid = !value.empty();
+                		} else if (flags[j] == 'S') {
+                    			std::string units = "KMG";
+                    			std::size_t unit = digits == std::string::npos ? std::string::npos : units.find(value[digits]);
+                    			valid = digits != 0 && !value.empty() && (digits == std::string::npos || (unit != std::string::npos && digits + 1 == value.size()));
+                    			options.memoryBudget = valid ? std::stoull(value.substr(0, digits)) << (unit == std::string::npos ? 0 : 10 * (unit + 1)) : 0;
+                		} else {
+                    			valid = false;
+                		}
+                		break;
+            		}
+        	}
+        	if (!valid || fileNames.empty()) {
+            		std::cout << "Usage: sort [-nru] [-k <field>[,<field>]] [-o <file>] [-S <size>[K|M|G]] <file>..." << std::endl;
+        	} else {
+            		fs.sort(fileNames, options, output);
+        	}
+    	} else if (com.getName() == "uniq") {
+        	// "uniq [-c] [-d] <file>"
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> fileNames;
+        	std::string flags;
+        	for (std::size_t i = 1; i < words.size(); ++i) {
+            		if (words[i].size() > 1 && words[i][0] == '-') {
+                		flags += words[i].substr(1);
+            		} else {
+                		fileNames.push_back(words[i]);
+            		}
+        	}
+        	if (fileNames.size() != 1 || flags.find_first_not_of("cd") != std::string::npos) {
+            		std::cout << "Usage: uniq [-c] [-d] <file>" << std::endl;
+        	} else {
+            		fs.uniq(fileNames[0], flags.find('c') != std::string::npos, flags.find('d') != std::string::npos);
+        	}
+    	} else if (com.getName() == "du") {
+        	// "du [-s] [-h] [--max-depth <n>|--max-depth=<n>] [<path>...]", parsed from the raw line.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> paths;
+        	int maxDepth = -1;
+        	bool human = false;
+        	bool valid = true;
+        	for (std::size_t i = 1; i < words.size(); ++i) {
+            		std::string depth;
+            		if (words[i].compare(0, 12, "--max-depth=") == 0) {
+                		depth = words[i].substr(12);
+            		} else if (words[i] == "--max-depth" && i + 1 < words.size()) {
+                		depth = words[++i];
+            		} else if (words[i].size() > 1 && words[i][0] == '-') {
+                		for (std::size_t j = 1; j < words[i].size(); ++j) {
+                    			maxDepth = words[i][j] == 's' ? 0 : maxDepth;
+                    			human = human || words[i][j] == 'h';
+                    			valid = valid && (words[i][j] == 's' || words[i][j] == 'h');
+                		}
+                		continue;
+            		} else {
+                		paths.push_back(words[i]);
+                		continue;
+            		}
+            		valid = valid && !depth.empty() && depth.find_first_not_of("0123456789") == std::string::npos;
+            		maxDepth = valid ? std::stoi(depth) : maxDepth;
+        	}
+        	if (!valid) {
+            		std::cout << "Usage: du [-s] [-h] [--max-depth <n>] [<path>...]" << std::endl;
+        	} else {
+            		if (paths.empty()) {
+                		paths.push_back(fs.getCurrentDirectory());
+            		}
+            		fs.du(paths, maxDepth, human);
+        	}
+    	} else if (com.getName() == "find") {
+        	// "find [<path>...] [-name <glob>] [-type f|d] [-perm [-|/]<mode>] [-maxdepth <n>] [-newer <file>]",
+        	// parsed from the raw line like grep.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+        	std::vector<std::string> paths;
+        	TreeFind::Criteria criteria;
+        	std::string newer;
+        	bool valid = true;
+        	std::size_t i = 1;
+        	for (; i < words.size() && words[i][0] != '-'; ++i) {
+            		paths.push_back(words[i]);
+        	}
+        	for (; i + 1 < words.size() && valid; i += 2) {
+            		std::string value = words[i + 1];
+            		if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0]) {
+                		value = value.substr(1, value.size() - 2);
+            		}
+            		if (words[i] == "-name") {
+                		criteria.hasName = true;
+                		criteria.name = value;
+            		} else if (words[i] == "-type" && (value == "f" || value == "d")) {
+                		criteria.type = value[0];
+            		} else if (words[i] == "-perm") {
+                		criteria.permissionMatch = value[0] == '-' ? TreeFind::PermissionMatch::AllOf : 
+                                           		   value[0] == '/' ? TreeFind::PermissionMatch::AnyOf : TreeFind::PermissionMatch::Exact;
+                		std::string digits = criteria.permissionMatch == TreeFind::PermissionMatch::Exact ? value : value.substr(1);
+                		valid = !digits.empty() && digits.size() <= 4 && digits.find_first_not_of("01234567") == std::string::npos;
+                		criteria.permissions = valid ? std::stoi(digits, nullptr, 8) & 0777 : -1;
+            		} else if (words[i] == "-maxdepth" && value.find_first_not_of("0123456789") == std::string::npos) {
+                		criteria.maxDepth = std::stoi(value);
+            		} else if (words[i] == "-newer") {
+                		newer = value;
+            		} else {
+                		valid = false;
+            		}
+        	}
+        	if (!valid || i != words.size()) {
+            		std::cout << "Usage: find [<path>...] [-name <glob>] [-type f|d] [-perm [-|/]<mode>] [-maxdepth <n>] [-newer <file>]" 
+                      		  << std::endl;
+        	} else {
+            		if (paths.empty()) {
+                		paths.push_back(fs.getCurrentDirectory());
+            		}
+            		fs.find(paths, criteria, newer);
+        	}
+    	} else if (com.getName() == "ln" || com.getName() == "ln -s") {
+        	fs.ln(com.getArguments().at(0), com.getArguments().at(1));
+    	} else if (com.getName() == "ps") {
+        	a.ps();
+    	} else if (com.getName() == "top") {
+        	a.top();
+    	} else if (com.getName() == "jobs") {
+        	a.jobs();
+    	} else if (com.getName() == "whatis") {
+        	std::vector<std::string> arguments = com.getArguments();
+        	a.whatis(arguments[0]);
+    	} else if (com.getName() == "fsstat") {
+        	fs.fsstat();
+    	} else if (com.getName() == "image") {
+        	// "image save <host path>" or "image load <host path>"
+        	std::vector<std::string> arguments = com.getArguments();
+        	std::string error;
+        	std::size_t entries = 0;
+        	if (arguments.size() == 2 && arguments[0] == "save") {
+            		if (fs.saveImage(arguments[1], entries, error)) {
+                		std::cout << "Saved " << entries << " entries to " << arguments[1] << std::endl;
+            		} else {
+                		std::cout << "Cannot save image: " << error << std::endl;
+            		}
+        	} else if (arguments.size() == 2 && arguments[0] == "load") {
+            		auto start = std::chrono::steady_clock::now();
+            		if (fs.loadImage(arguments[1], entries, error)) {
+                		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                		std::cout << "Loaded " << entries << " entries from " << arguments[1] << " in " << std::fixed 
+                          		  << std::setprecision(1) << elapsed.count() << std::defaultfloat << " ms" << std::endl;
+                		// The journal cannot replay a host file, so the loaded state starts a checkpoint.
+                		if (journal != nullptr && !replaying) {
+                    			checkpoint();
+                		}
+            		} else {
+                		std::cout << "Cannot load image: " << error << std::endl;
+            		}
+        	} else {
+            		std::cout << "Invalid arguments for 'image' command." << std::endl;
+        	}
+    	} else if (com.getName() == "export") {
+        	// "export [-j <threads>] <path> <host dir>"
+        	std::vector<std::string> arguments = com.getArguments();
+        	unsigned threads = TreeExport::defaultThreads();
+        	std::map<std::string, std::vector<std::string>> options = com.getOptions();
+        	auto jobs = options.find("-j");
+        	if (jobs != options.end() && !jobs->second.empty()) {
+            		threads = static_cast<unsigned>(std::max(std::atoi(jobs->second[0].c_str()), 1));
+            		arguments.insert(arguments.begin(), jobs->second.begin() + 1, jobs->second.end());
+        	}
+        	TreeExport::Stats stats;
+        	std::string error;
+        	if (arguments.size() != 2) {
+            		std::cout << "Invalid arguments for 'export' command." << std::endl;
+        	} else if (fs.exportTree(arguments[0], arguments[1], threads, stats, error)) {
+            		double megabytes = stats.bytes / 1048576.0;
+            		std::cout << "Exported " << stats.files << " files, " << stats.links << " links and " << stats.directories 
+                      		  << " directories (" << std::fixed << std::setprecision(1) << megabytes << " MB) in " 
+                      		  << stats.seconds * 1000 << " ms, " << (stats.seconds > 0 ? megabytes / stats.seconds : 0) 
+                      		  << " MB/s with " << stats.threads << " threads" << std::defaultfloat << std::endl;
+        	} else {
+            		std::cout << "Cannot export " << arguments[0] << ": " << error << std::endl;
+        	}
+    	} else if (com.getName() == "journal") {
+        	journalCommand(com.getArguments());
+    	} else if (com.getName() == "reclaim") {
+        	// "reclaim deferred|immediate|status"
+        	std::vector<std::string> arguments = com.getArguments();
+        	if (arguments.size() == 1 && (arguments[0] == "deferred" || arguments[0] == "immediate")) {
+            		fs.setDeferredReclaim(arguments[0] == "deferred");
+            		fs.reclaimStatus();
+        	} else if (arguments.size() == 1 && arguments[0] == "status") {
+            		fs.reclaimStatus();
+        	} else {
+            		std::cout << "Usage: reclaim deferred|immediate|status" << std::endl;
+        	}
+    	} else if (com.getName() == "compress") {
+        	// "compress <idle seconds>" or "compress off"
+        	std::vector<std::string> arguments = com.getArguments();
+        	if (arguments.size() != 1 || (arguments[0] != "off" && arguments[0].find_first_not_of("0123456789") != std::string::npos)) {
+            		std::cout << "Invalid arguments for 'compress' command." << std::endl;
+        	} else {
+            		fs.setCompressionIdleTime(arguments[0] == "off" ? -1 : std::stol(arguments[0]));
+        	}
+    	} else {
+        	std::cout << "Unknown command: " << com.getName() << std::endl;
+    	}
+    	if (journal != nullptr && !replaying && isJournaled(com)) {
+        	if (com.getName() == "vim") {
+            		journal->append('W', directory, com.getArguments().at(0), written);
+        	} else {
+            		journal->append('C', directory, com.getLine());
+        	}
+        	std::string error = journal->getError();
+        	if (!error.empty()) {
+            		std::cout << "Journal write failed: " << error << std::endl;
+        	} else if (journal->getRecordsSinceCheckpoint() >= checkpointInterval) {
+            		checkpoint();
+        	}
+    	}
+    	fs.compressIdleContents();
+}
+
+// Commands that change the file system or the user list.
+bool CommandExecutor::isJournaled(const Command& com) {
+    	static const std::vector<std::string> mutating = {
+        	"mkdir", "touch", "vim", "rmdir", "rm", "mv", "cp", "ln", "chmod", "useradd"
+    	};
+    	if (com.getName() == "echo") {
+        	std::vector<std::string> text = com.getArguments();
+        	return std::find(text.begin(), text.end(), ">") != text.end() || std::find(text.begin(), text.end(), ">>") != text.end();
+    	}
+    	if (com.getName() == "sort") {
+        	// Only "sort -o" writes a file.
+        	std::vector<std::string> words = com.splitCommand(com.getLine(), ' ');
+        	return std::any_of(words.begin(), words.end(), [](const std::string& word) {
+            		return word.size() > 1 && word[0] == '-' && word.find('o') != std::string::npos;
+        	});
+    	}
+    	return std::find(mutating.begin(), mutating.end(), com.getName()) != mutating.end();
+}
+
+// "journal open <host dir>", "journal sync always|never|<ms>",
+// "journal checkpoint [<records>]", "journal status" or "journal close".
+void CommandExecutor::journalCommand(const std::vector<std::string>& arguments) {
+    	std::string action = arguments.empty() ? "" : arguments[0];
+    	bool number = arguments.size() == 2 && arguments[1].find_first_not_of("0123456789") == std::string::npos;
+    	if (action == "open" && arguments.size() == 2) {
+        	openJournal(arguments[1]);
+    	} else if (journal == nullptr && !action.empty()) {
+        	std::cout << "No journal is open." << std::endl;
+    	} else if (action == "sync" && arguments.size() == 2 && (arguments[1] == "always" || arguments[1] == "never" || number)) {
+        	Journal::SyncPolicy policy = arguments[1] == "always" ? Journal::SyncPolicy::Always : 
+                                     	     arguments[1] == "never" ? Journal::SyncPolicy::Never : Journal::SyncPolicy::Interval;
+        	journal->setSyncPolicy(policy, number ? std::stoul(arguments[1]) : journal->getInterval());
+    	} else if (action == "checkpoint" && arguments.size() == 1) {
+        	checkpoint();
+    	} else if (action == "checkpoint" && number) {
+        	checkpointInterval = std::max(std::stoul(arguments[1]), 1UL);
+    	} else if (action == "status" && arguments.size() == 1) {
+        	Journal::SyncPolicy policy = journal->getSyncPolicy();
+        	unsigned long long groups = journal->getGroups();
+        	std::cout << "Journal: " << journal->getDirectory() << ", sequence " << journal->getSequence() << std::endl;
+        	std::cout << "Sync: " << (policy == Journal::SyncPolicy::Always ? "always" : 
+                                  	  policy == Journal::SyncPolicy::Never ? "never" : "every " + std::to_string(journal->getInterval()) + " ms") 
+                  	  << std::endl;
+        	std::cout << "Records since checkpoint: " << journal->getRecordsSinceCheckpoint() << " (checkpoint every " 
+                  	  << checkpointInterval << ")" << std::endl;
+        	std::cout << "Group commits: " << groups << ", fsyncs: " << journal->getSyncs() << ", bytes written: " 
+                  	  << journal->getBytesWritten() << std::endl;
+        	if (!journal->getError().empty()) {
+            		std::cout << "Last write failed: " << journal->getError() << std::endl;
+        	}
+    	} else if (action == "close" && arguments.size() == 1) {
+        	journal->close();
+        	if (!journal->getError().empty()) {
+            		std::cout << "Journal close failed: " << journal->getError() << std::endl;
+        	}
+        	journal.reset();
+    	} else {
+        	std::cout << "Invalid arguments for 'journal' command." << std::endl;
+    	}
+}
+
+// Recovers the state kept in directory: the newest checkpoint, then the
+// records journaled after it, replayed with their output suppressed. A new
+// journal starts with a checkpoint of the current state. If the checkpoint
+// cannot be loaded nothing is replayed and the journal is left closed.
+void CommandExecutor::openJournal(const std::string& directory) {
+    	std::shared_ptr<Journal> opened = std::make_shared<Journal>();
+    	std::string error;
+    	if (!opened->open(directory, error)) {
+        	std::cout << "Cannot open journal: " << error << std::endl;
+        	return;
+    	}
+    	journal = opened;
+    	std::uint64_t checkpointSequence = 0;
+    	bool hasCheckpoint = journal->latestCheckpoint(checkpointSequence);
+    	std::vector<JournalRecord> records = journal->readRecords(checkpointSequence);
+    	if (!hasCheckpoint && records.empty()) {
+        	checkpoint();
+        	std::cout << "Started a new journal in " << directory << std::endl;
+        	return;
+    	}
+    	std::string base = journal->checkpointPath(checkpointSequence);
+    	std::size_t entries = 0;
+    	if (hasCheckpoint && !fs.loadImage(base + ".img", entries, error)) {
+        	journal.reset();
+        	std::cout << "Cannot load checkpoint: " << error << std::endl;
+        	return;
+    	}
+    	if (journal->getDroppedBytes() != 0) {
+        	std::cout << "Dropped " << journal->getDroppedBytes() << " bytes of torn journal tail" << std::endl;
+    	}
+    	replaying = true;
+    	std::streambuf* output = std::cout.rdbuf(nullptr);
+    	if (hasCheckpoint) {
+        	std::ifstream users(base + ".users");
+        	std::string name;
+        	while (std::getline(users, name)) {
+            		u.useradd(name);
+        	}
+    	}
+    	for (const JournalRecord& record : records) {
+        	fs.setCurrentDirectory(record.directory);
+        	if (record.type == 'W') {
+            		fs.createFile(record.text);
+            		fs.echoToFile(record.text, record.content, false);
+        	} else {
+            		execute(Command(record.text));
+        	}
+    	}
+    	fs.setCurrentDirectory("/");
+    	std::cout.rdbuf(output);
+    	std::cout.clear();
+    	replaying = false;
+    	std::cout << "Recovered " << (hasCheckpoint ? "checkpoint " + std::to_string(checkpointSequence) : "no checkpoint") 
+              	  << " and replayed " << records.size() << " journal records from " << directory << std::endl;
+}
+
+// Writes the user list and then the image under the checkpoint's name; the
+// image appears last, atomically, and marks the checkpoint complete.
+void CommandExecutor::checkpoint() {
+    	std::string error;
+    	if (!journal->flush(error)) {
+        	std::cout << "Checkpoint failed: " << error << std::endl;
+        	return;
+    	}
+    	std::uint64_t sequence = journal->getSequence();
+    	std::string base = journal->checkpointPath(sequence);
+    	std::size_t entries = 0;
+    	{
+        	std::ofstream users(base + ".users.tmp", std::ios::trunc);
+        	for (const User& user : u.getUsers()) {
+            		users << user.getName() << '\n';
+        	}
+    	}
+    	if (!Journal::replaceFile(base + ".users.tmp", base + ".users") || !fs.saveImage(base + ".img.tmp", entries, error) || 
+        	!Journal::replaceFile(base + ".img.tmp", base + ".img") || !journal->finishCheckpoint(sequence, error)) {
+        	std::cout << "Checkpoint failed" << (error.empty() ? "" : ": " + error) << std::endl;
+    	}
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_COMMANDEXECUTOR_H
@@ -1,127 +1,162 @@
-#ifndef LINUX_EMULATOR_COMMANDVALIDATOR_H
-#define LINUX_EMULATOR_COMMANDVALIDATOR_H
-
-#include "command.h"
-
-#include <map>
-#include <algorithm>
-#include <regex>
-
-namespace LinuxEmulator {
-
-class CommandValidator {
-public:
-    CommandValidator();
-    CommandValidator(const Command&);
-    bool isValidCommand(const Command&);
-    Command getCommand() const;
-    std::map<std::string, std::vector<std::string>> getValidOptions() const;
-private:
-    Command command;
-    std::vector<std::string> validCommands = {
-        "date",
-        "cal",
-        "df",
-        "free",
-        "mkdir",
-        "ls",
-        "pwd",
-        "cd",
-        "touch",
-        "cat",
-        "vim",
-        "file",
-        "mv",
-        "cp",
-        "rm",
-        "less",
-        "rmdir",
-        "ln",
-        "wc",
-        "head",
-        "tail",
-        "echo",
-        "history",
-        "clear",
-        "passwd",
-        "id",
-        "help",
-        "ssh",
-        "useradd",
-        "chmod",
-        "ps",
-        "top",
-        "jobs",
-        "whatis"
-    };
-    std::map<std::string, std::vector<std::string>> validOptions = {
-        {"cal", {}},
-        {"date", {}},
-        {"df", {}},
-        {"free", {}},
-        {"mkdir", {}},
-        {"ls", {"-l", "-la", "-lt"}},
-        {"pwd", {}},
-        {"cd", {"..", ".", "~", "-"}},
-        {"touch", {}},
-        {"cat", {}},
-        {"vim", {}},
-        {"file", {}},
-        {"mv", {}},
-        {"cp", {}},
-        {"rm", {}},
-        {"less", {}},
-        {"ln", {"-s"}},
-        {"wc", {}},
-        {"head", {}},
-        {"tail", {}},
-        {"echo", {}},
-        {"history", {}},
-        {"clear", {}},
-        {"id", {}},
-        {"passwd", {}},
-        {"help", {}},
-        {"ssh", {}},
-        {"useradd", {}},
-        {"chmod", {}},
-        {"ps", {}},
-        {"top", {}},
-        {"jobs", {}},
-        {"whatis", {}}
-    };
-};
-
-CommandValidator::CommandValidator() = default;
-
-CommandValidator::CommandValidator(const Command& com) : command(com) {}
-
-Command CommandValidator::getCommand() const {
-    return command;
-}
-
-std::map<std::string, std::vector<std::string>> CommandValidator::getValidOptions() const {
-    return validOptions;
-}
-
-bool CommandValidator::isValidCommand(const Command& com) {
-    std::string commandName = com.getName();
-    if (std::find(validCommands.begin(), validCommands.end(), commandName) == validCommands.end()) {
-        return false;
-    }
-    const std::map<std::string, std::vector<std::string>>& options = com.getOptions();
-    const std::vector<std::string>& validOpts = validOptions[commandName];
-    for (const auto& pair : options) {
-        const std::vector<std::string>& opts = pair.second;
-        for (const std::string& opt : opts) {
-            if (std::find(validOpts.begin(), validOpts.end(), opt) == validOpts.end()) {
-                return false;
-            }
-        }
-    }
-    const std::vector<std::string>& arguments = com.getArguments();
-    return true;
-}
-
-} // namespace LinuxEmulator
-
+#ifndef LINUX_EMULATOR_COMMANDVALIDATOR_H
+#define LINUX_EMULATOR_COMMANDVALIDATOR_H
+
+#include "command.h"
+
+#include <map>
+#include <algorithm>
+#include <regex>
+
+namespace LinuxEmulator {
+
+class CommandValidator {
+public:
+    CommandValidator();
+    CommandValidator(const Command&);
+    bool isValidCommand(const Command&);
+    Command getCommand() const;
+    std::map<std::string, std::vector<std::string>> getValidOptions() const;
+private:
+    Command command;
+    std::vector<std::string> validCommands = {
+        "date",
+        "cal",
+        "df",
+        "free",
+        "mkdir",
+        "ls",
+        "pwd",
+        "cd",
+        "touch",
+        "cat",
+        "vim",
+        "file",
+        "mv",
+        "cp",
+        "rm",
+        "less",
+        "rmdir",
+        "ln",
+        "wc",
+        "head",
+        "tail",
+        "echo",
+        "history",
+        "clear",
+        "passwd",
+        "id",
+        "help",
+        "ssh",
+        "useradd",
+        "chmod",
+        "ps",
+        "top",
+        "jobs",
+        "whatis",
+        "fsstat",
+        "compress",
+        "reclaim",
+        "image",
+        "export",
+        "grep",
+        "sort",
+        "uniq",
+        "find",
+        "du",
+        "journal"
+    };
+    std::map<std::string, std::vector<std::string>> validOptions = {
+        {"cal", {}},
+        {"date", {}},
+        {"df", {"-h", "-i", "--capacity"}},
+        {"free", {}},
+        {"mkdir", {}},
+        {"ls", {"-l", "-la", "-lt"}},
+        {"pwd", {}},
+        {"cd", {"..", ".", "~", "-"}},
+        {"touch", {}},
+        {"cat", {}},
+        {"vim", {}},
+        {"file", {}},
+        {"mv", {}},
+        {"cp", {"-r", "-R", "-a"}},
+        {"rm", {"-r", "-R", "-f"}},
+        {"less", {}},
+        {"ln", {"-s"}},
+        {"wc", {"-l", "-w", "-c"}},
+        {"head", {"-n", "-c"}},
+        {"tail", {"-n", "-c"}},
+        {"echo", {}},
+        {"history", {}},
+        {"clear", {}},
+        {"id", {}},
+        {"passwd", {}},
+        {"help", {}},
+        {"ssh", {}},
+        {"useradd", {}},
+        {"chmod", {}},
+        {"ps", {}},
+        {"top", {}},
+        {"jobs", {}},
+        {"whatis", {}},
+        {"fsstat", {}},
+        {"compress", {}},
+        {"reclaim", {}},
+        {"image", {}},
+        {"export", {"-j"}},
+        {"grep", {"-r", "-i", "-n", "-c", "-l", "-E", "-F"}},
+        {"sort", {"-n", "-r", "-u", "-k", "-o", "-S"}},
+        {"uniq", {"-c", "-d"}},
+        {"find", {"-name", "-type", "-perm", "-maxdepth", "-newer"}},
+        {"du", {"-s", "-h", "--max-depth"}},
+        {"journal", {}}
+    };
+};
+
+CommandValidator::CommandValidator() = default;
+
+CommandValidator::CommandValidator(const Command& com) : command(com) {}
+
+Command CommandValidator::getCommand() const {
+    return command;
+}
+
+std::map<std::string, std::vector<std::string>> CommandValidator::getValidOptions() const {
+    return validOptions;
+}
+
+bool CommandValidator::isValidCommand(const Command& com) {
+    std::string commandName = com.getName();
+    if (std::find(validCommands.begin(), validCommands.end(), commandName) == validCommands.end()) {
+        return false;
+    }
+    const std::map<std::string, std::vector<std::string>>& options = com.getOptions();
+    const std::vector<std::string>& validOpts = validOptions[commandName];
+    // Values that follow an option belong to it; only the names are checked.
+    // Single-letter options may be combined, as in "-rn".
+    for (const auto& pair : options) {
+        if (std::find(validOpts.begin(), validOpts.end(), pair.first) != validOpts.end()) {
+            continue;
+        }
+        // "--name=value" carries its value along.
+        std::size_t equals = pair.first.find('=');
+        if (pair.first.compare(0, 2, "--") == 0 && equals != std::string::npos && 
+            std::find(validOpts.begin(), validOpts.end(), pair.first.substr(0, equals)) != validOpts.end()) {
+            continue;
+        }
+        if (pair.first.size() < 2 || pair.first[1] == '-') {
+            return false;
+        }
+        for (std::size_t i = 1; i < pair.first.size(); ++i) {
+            if (std::find(validOpts.begin(), validOpts.end(), std::string("-") + pair.first[i]) == validOpts.end()) {
+                return false;
+            }
+        }
+    }
+    const std::vector<std::string>& arguments = com.getArguments();
+    return true;
+}
+
+} // namespace LinuxEmulator
+
 #endif // LINUX_EMULATOR_COMMANDVALIDATOR_H
\ No newline at end of file
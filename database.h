@@ -1,86 +1,94 @@
-#ifndef LINUX_EMULATOR_DATABASE_H
-#define LINUX_EMULATOR_DATABASE_H
-
-#include "question.h"
-#include "answer.h"
-
-#include <vector>
-#include <fstream>
-#include <unordered_map>
-
-namespace LinuxEmulator {
-
-class Database {
-public:
-	Database();
-	void setQuestions(const std::vector<Question>&);
-	std::vector<Question> getQuestions() const;
-	void setAnswers(const std::vector<Answer>&);
-	std::vector<Answer> getAnswers() const;
-	void addQuestion(const Question&);
-	void addAnswer(const Answer&);
-	void loadQuestions(const std::string&);
-	void loadAnswers(const std::string&);
-private:
-	std::vector<Question> questions;
-	std::vector<Answer> answers;
-};
-
-Database::Database() = default;
-
-void Database::setQuestions(const std::vector<Question>& q) {
-	questions = q;
-}
-
-std::vector<Question> Database::getQuestions() const {
-	return questions;
-}
-
-void Database::setAnswers(const std::vector<Answer>& a) {
-	answers = a;
-}
-
-std::vector<Answer> Database::getAnswers() const {
-	return answers;
-}
-
-void Database::addQuestion(const Question& q) {
-	questions.push_back(q);
-}
-
-void Database::addAnswer(const Answer& a) {
-	answers.push_back(a);
-}
-
-void Database::loadQuestions(const std::string& filename) {
-	std::ifstream file(filename);
-	if (!file.is_open()) {
-		std::cout << "Can not open file" << std::endl;
-		return;
-	}
-	std::string line;
-	while (std::getline(file, line)) {
-		Question question(line);
-		addQuestion(question);
-	}
-	file.close();
-}
-
-void Database::loadAnswers(const std::string& filename) {
-	std::ifstream file(filename);
-	if (!file.is_open()) {
-		std::cout << "Can not open file" << std::endl;
-		return;
-	}
-	std::string line;
-	while (std::getline(file, line)) {
-		Answer answer(line);
-		addAnswer(answer);
-	}
-	file.close();
-}
-
-
-} // namespace LinuxEmulator
-
+#ifndef LINUX_EMULATOR_DATABASE_H
+#define LINUX_EMULATOR_DATABASE_H
+
+#include "question.h"
+#include "answer.h"
+
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+
+namespace LinuxEmulator {
+
+class Database {
+public:
+	Database();
+	void setQuestions(const std::vector<Question>&);
+	std::vector<Question> getQuestions() const;
+	void setAnswers(const std::vector<Answer>&);
+	std::vector<Answer> getAnswers() const;
+	void addQuestion(const Question&);
+	void addAnswer(const Answer&);
+	void loadQuestions(const std::string&);
+	void loadAnswers(const std::string&);
+private:
+	static std::string stripLineEnd(const std::string&);
+	std::vector<Question> questions;
+	std::vector<Answer> answers;
+};
+
+Database::Database() = default;
+
+void Database::setQuestions(const std::vector<Question>& q) {
+	questions = q;
+}
+
+std::vector<Question> Database::getQuestions() const {
+	return questions;
+}
+
+void Database::setAnswers(const std::vector<Answer>& a) {
+	answers = a;
+}
+
+std::vector<Answer> Database::getAnswers() const {
+	return answers;
+}
+
+void Database::addQuestion(const Question& q) {
+	questions.push_back(q);
+}
+
+void Database::addAnswer(const Answer& a) {
+	answers.push_back(a);
+}
+
+// The files may come with CRLF line endings; the '\r' and any other trailing
+// blanks would otherwise end up in the commands the exam runs.
+std::string Database::stripLineEnd(const std::string& line) {
+	std::size_t end = line.find_last_not_of(" \t\r\n");
+	return end == std::string::npos ? std::string() : line.substr(0, end + 1);
+}
+
+void Database::loadQuestions(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		std::cout << "Can not open file" << std::endl;
+		return;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		Question question(stripLineEnd(line));
+		addQuestion(question);
+	}
+	file.close();
+}
+
+void Database::loadAnswers(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		std::cout << "Can not open file" << std::endl;
+		return;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		Answer answer(stripLineEnd(line));
+		addAnswer(answer);
+	}
+	file.close();
+}
+
+
+} // namespace LinuxEmulator
+
 #endif // LINUX_EMULATOR_DATABASE_H
\ No newline at end of file
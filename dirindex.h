@@ -0,0 +1,209 @@
+#ifndef LINUX_EMULATOR_DIRINDEX_H
+#define LINUX_EMULATOR_DIRINDEX_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Name -> entry hash index of a single directory: open addressing with linear
+// probing and backward-shift deletion. Each slot also records where the entry
+// sits in the directory's child list, so that an entry can be taken out of
+// the list without searching it. The table is only built once a directory
+// outgrows inlineThreshold entries; smaller directories are scanned linearly
+// through their child list, so an inactive index costs one pointer and two
+// counters per node.
+template <typename Entry>
+class DirectoryIndex {
+public:
+    static const std::size_t inlineThreshold = 8;
+    static const std::uint32_t npos = 0xffffffff;
+    DirectoryIndex();
+    DirectoryIndex(const DirectoryIndex&) = delete;
+    DirectoryIndex& operator=(const DirectoryIndex&) = delete;
+    ~DirectoryIndex();
+    bool isActive() const;
+    void build(const std::vector<Entry*>&);
+    Entry* find(const std::string&) const;
+    std::uint32_t position(const std::string&) const;
+    bool setPosition(const std::string&, std::uint32_t);
+    bool insert(Entry*, std::uint32_t);
+    bool erase(const std::string&);
+    std::size_t size() const;
+    void clear();
+private:
+    // Only the low half of the name's hash is kept, which is all the mask
+    // of a table with 32-bit capacity can use; it keeps a slot at two words.
+    struct Slot {
+        std::uint32_t hash;
+        std::uint32_t position;
+        Entry* entry;
+    };
+    static std::uint32_t hashName(const std::string&);
+    Slot* lookup(const std::string&) const;
+    void resize(std::uint32_t);
+    void placeInTable(const Slot&);
+    Slot* table;
+    std::uint32_t capacity;
+    std::uint32_t count;
+};
+
+template <typename Entry>
+DirectoryIndex<Entry>::DirectoryIndex() : table{nullptr}, capacity{0}, count{0} {}
+
+template <typename Entry>
+DirectoryIndex<Entry>::~DirectoryIndex() {
+    delete[] table;
+}
+
+template <typename Entry>
+std::uint32_t DirectoryIndex<Entry>::hashName(const std::string& name) {
+    return static_cast<std::uint32_t>(std::hash<std::string>{}(name));
+}
+
+template <typename Entry>
+bool DirectoryIndex<Entry>::isActive() const {
+    return table != nullptr;
+}
+
+template <typename Entry>
+std::size_t DirectoryIndex<Entry>::size() const {
+    return count;
+}
+
+template <typename Entry>
+void DirectoryIndex<Entry>::clear() {
+    delete[] table;
+    table = nullptr;
+    capacity = 0;
+    count = 0;
+}
+
+template <typename Entry>
+void DirectoryIndex<Entry>::build(const std::vector<Entry*>& entries) {
+    clear();
+    std::uint32_t initialCapacity = inlineThreshold * 4;
+    while ((entries.size() + 1) * 4 > initialCapacity * 3) {
+        initialCapacity *= 2;
+    }
+    resize(initialCapacity);
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        insert(entries[i], static_cast<std::uint32_t>(i));
+    }
+}
+
+template <typename Entry>
+typename DirectoryIndex<Entry>::Slot* DirectoryIndex<Entry>::lookup(const std::string& name) const {
+    if (table == nullptr) {
+        return nullptr;
+    }
+    std::size_t mask = capacity - 1;
+    std::uint32_t hash = hashName(name);
+    for (std::size_t i = hash & mask; table[i].entry != nullptr; i = (i + 1) & mask) {
+        if (table[i].hash == hash && table[i].entry->getName() == name) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+template <typename Entry>
+Entry* DirectoryIndex<Entry>::find(const std::string& name) const {
+    Slot* slot = lookup(name);
+    return slot == nullptr ? nullptr : slot->entry;
+}
+
+// Index of the entry in the child list, or npos.
+template <typename Entry>
+std::uint32_t DirectoryIndex<Entry>::position(const std::string& name) const {
+    Slot* slot = lookup(name);
+    return slot == nullptr ? npos : slot->position;
+}
+
+template <typename Entry>
+bool DirectoryIndex<Entry>::setPosition(const std::string& name, std::uint32_t position) {
+    Slot* slot = lookup(name);
+    if (slot == nullptr) {
+        return false;
+    }
+    slot->position = position;
+    return true;
+}
+
+template <typename Entry>
+void DirectoryIndex<Entry>::placeInTable(const Slot& slot) {
+    std::size_t mask = capacity - 1;
+    std::size_t i = slot.hash & mask;
+    while (table[i].entry != nullptr) {
+        i = (i + 1) & mask;
+    }
+    table[i] = slot;
+}
+
+template <typename Entry>
+void DirectoryIndex<Entry>::resize(std::uint32_t newCapacity) {
+    Slot* old = table;
+    std::uint32_t oldCapacity = capacity;
+    table = new Slot[newCapacity]();
+    capacity = newCapacity;
+    for (std::uint32_t i = 0; i < oldCapacity; ++i) {
+        if (old[i].entry != nullptr) {
+            placeInTable(old[i]);
+        }
+    }
+    delete[] old;
+}
+
+template <typename Entry>
+bool DirectoryIndex<Entry>::insert(Entry* entry, std::uint32_t position) {
+    if (table == nullptr || find(entry->getName()) != nullptr) {
+        return false;
+    }
+    // Keep the load factor below 3/4 so probe sequences stay short.
+    if ((count + 1) * 4 > capacity * 3) {
+        resize(capacity * 2);
+    }
+    placeInTable(Slot{hashName(entry->getName()), position, entry});
+    ++count;
+    return true;
+}
+
+template <typename Entry>
+bool DirectoryIndex<Entry>::erase(const std::string& name) {
+    if (table == nullptr) {
+        return false;
+    }
+    std::size_t mask = capacity - 1;
+    std::uint32_t hash = hashName(name);
+    std::size_t i = hash & mask;
+    while (table[i].entry != nullptr) {
+        if (table[i].hash == hash && table[i].entry->getName() == name) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    if (table[i].entry == nullptr) {
+        return false;
+    }
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole so that no tombstones are needed.
+    std::size_t hole = i;
+    for (std::size_t j = (hole + 1) & mask; table[j].entry != nullptr; j = (j + 1) & mask) {
+        std::size_t home = table[j].hash & mask;
+        bool movable = hole <= j ? (home <= hole || home > j) : (home <= hole && home > j);
+        if (movable) {
+            table[hole] = table[j];
+            hole = j;
+        }
+    }
+    table[hole] = Slot{0, 0, nullptr};
+    --count;
+    return true;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_DIRINDEX_H
@@ -0,0 +1,283 @@
+#ifndef LINUX_EMULATOR_EXPORT_H
+#define LINUX_EMULATOR_EXPORT_H
+
+#include "gtree.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Writes a subtree of a GeneralTree to a directory on the host: directories,
+// file contents, hard links, permission bits and modification times.
+//
+// The tree is walked once on the calling thread, which creates the host
+// directories parents first and lists every file together with the extents
+// of its content. Listing the extents also restores compressed blobs, so the
+// workers only ever read plain bytes and never touch a ContentBuffer, whose
+// reads update its access time. The files are cut into batches of about
+// batchBytes, and a pool of workers claims batches in order and writes each
+// file with large writev calls straight from the extents. Hard links and the
+// directory modes are applied on the calling thread once the pool is done,
+// deepest directories first, so a read-only directory is filled before it
+// loses its write bit.
+class TreeExport {
+public:
+    struct Stats {
+        std::uint64_t directories;
+        std::uint64_t files;
+        std::uint64_t links;
+        std::uint64_t bytes;
+        unsigned threads;
+        double seconds;
+        Stats();
+    };
+    static unsigned defaultThreads();
+    static bool run(const Node*, const std::string&, unsigned, Stats&, std::string&);
+private:
+    static const std::size_t batchBytes = 4 << 20;
+    static const std::size_t batchFiles = 256;
+    struct FileJob {
+        std::string path;
+        std::vector<std::string_view> pieces;
+        std::uint64_t size;
+        int mode;
+        std::time_t modified;
+    };
+    struct Entry {
+        std::string path;
+        const File* data;
+    };
+    struct Visit {
+        std::string path;
+        const Node* node;
+    };
+    static bool writeFile(const FileJob&, std::string&);
+    static bool setTimes(const std::string&, std::time_t, std::string&);
+    static std::string describe(const std::string&, const std::string&, int);
+};
+
+TreeExport::Stats::Stats() : directories{0}, files{0}, links{0}, bytes{0}, threads{0}, seconds{0} {}
+
+unsigned TreeExport::defaultThreads() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::min(std::max(cores, 1U), 8U);
+}
+
+std::string TreeExport::describe(const std::string& action, const std::string& path, int code) {
+    return action + " " + path + ": " + std::strerror(code);
+}
+
+bool TreeExport::setTimes(const std::string& path, std::time_t modified, std::string& error) {
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = modified;
+    times[1].tv_nsec = 0;
+    if (utimensat(AT_FDCWD, path.c_str(), times, 0) != 0) {
+        error = describe("cannot set times of", path, errno);
+        return false;
+    }
+    return true;
+}
+
+// Writes one file from its extents, IOV_MAX extents per system call.
+bool TreeExport::writeFile(const FileJob& job, std::string& error) {
+    int fd = ::open(job.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = describe("cannot create", job.path, errno);
+        return false;
+    }
+    std::vector<struct iovec> vectors;
+    vectors.reserve(job.pieces.size());
+    for (std::string_view piece : job.pieces) {
+        vectors.push_back({const_cast<char*>(piece.data()), piece.size()});
+    }
+    std::size_t next = 0;
+    while (next < vectors.size()) {
+        int count = static_cast<int>(std::min<std::size_t>(vectors.size() - next, IOV_MAX));
+        ssize_t written = ::writev(fd, vectors.data() + next, count);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            error = describe("cannot write", job.path, errno);
+            ::close(fd);
+            return false;
+        }
+        // A short write leaves the rest of the current extent to retry.
+        std::size_t left = static_cast<std::size_t>(written);
+        while (next < vectors.size() && left >= vectors[next].iov_len) {
+            left -= vectors[next].iov_len;
+            ++next;
+        }
+        if (left > 0) {
+            vectors[next].iov_base = static_cast<char*>(vectors[next].iov_base) + left;
+            vectors[next].iov_len -= left;
+        }
+    }
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = job.modified;
+    times[1].tv_nsec = 0;
+    bool ok = ::fchmod(fd, static_cast<mode_t>(job.mode)) == 0 && ::futimens(fd, times) == 0;
+    if (!ok) {
+        error = describe("cannot set attributes of", job.path, errno);
+    }
+    if (::close(fd) != 0 && ok) {
+        error = describe("cannot write", job.path, errno);
+        ok = false;
+    }
+    return ok;
+}
+
+// Exports root to hostDirectory: a directory becomes hostDirectory itself
+// (created if needed), a file is written into it under its own name.
+bool TreeExport::run(const Node* root, const std::string& hostDirectory, unsigned threads, Stats& stats,
+                     std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    stats = Stats();
+    if (::mkdir(hostDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+        error = describe("cannot create", hostDirectory, errno);
+        return false;
+    }
+    struct stat target;
+    if (::stat(hostDirectory.c_str(), &target) != 0 || !S_ISDIR(target.st_mode)) {
+        error = hostDirectory + " is not a directory";
+        return false;
+    }
+
+    std::vector<FileJob> jobs;
+    std::vector<Entry> links;
+    std::vector<Entry> directories;
+    std::unordered_map<const File*, std::string> exported;
+    if (root->parent != nullptr && !Node::isValidName(root->getName())) {
+        error = "invalid entry name '" + root->getName() + "'";
+        return false;
+    }
+    std::vector<Visit> pending;
+    pending.push_back({root->data->getIsDirectory() ? hostDirectory : hostDirectory + "/" + root->getName(), root});
+    while (!pending.empty()) {
+        Visit visit = std::move(pending.back());
+        pending.pop_back();
+        const File* data = visit.node->data;
+        if (data->getIsDirectory()) {
+            if (::mkdir(visit.path.c_str(), 0700) != 0 && errno != EEXIST) {
+                error = describe("cannot create", visit.path, errno);
+                return false;
+            }
+            directories.push_back({visit.path, data});
+            for (const Node* child : visit.node->children) {
+                // Such a name would lead the host path out of the target.
+                if (!Node::isValidName(child->getName())) {
+                    error = "invalid entry name '" + child->getName() + "' in " + visit.path;
+                    return false;
+                }
+                pending.push_back({visit.path + "/" + child->getName(), child});
+            }
+            continue;
+        }
+        auto first = exported.emplace(data, visit.path);
+        if (!first.second) {
+            links.push_back({visit.path, data});
+            continue;
+        }
+        const ContentBuffer& content = data->getContent();
+        FileJob job{visit.path, {}, content.size(), data->getOctalPermissions(), data->getModifiedTime()};
+        job.pieces.reserve(content.chunkCount());
+        for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+            job.pieces.push_back(content.chunk(i));
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    std::vector<std::size_t> batchEnds;
+    std::size_t batchSize = 0;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        batchSize += jobs[i].size;
+        if (batchSize >= batchBytes || i + 1 == jobs.size() ||
+            (batchEnds.empty() ? i + 1 : i + 1 - batchEnds.back()) >= batchFiles) {
+            batchEnds.push_back(i + 1);
+            batchSize = 0;
+        }
+    }
+    threads = std::max(1U, std::min<unsigned>(threads, static_cast<unsigned>(batchEnds.size())));
+    std::atomic<std::size_t> nextBatch{0};
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    auto work = [&]() {
+        std::string workerError;
+        for (std::size_t batch = nextBatch++; batch < batchEnds.size() && !failed; batch = nextBatch++) {
+            for (std::size_t i = batch == 0 ? 0 : batchEnds[batch - 1]; i < batchEnds[batch]; ++i) {
+                if (!writeFile(jobs[i], workerError)) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!failed.exchange(true)) {
+                        error = workerError;
+                    }
+                    return;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+    if (failed) {
+        return false;
+    }
+
+    for (const Entry& link : links) {
+        const std::string& source = exported[link.data];
+        ::unlink(link.path.c_str());
+        if (::link(source.c_str(), link.path.c_str()) != 0) {
+            error = describe("cannot link", link.path, errno);
+            return false;
+        }
+    }
+    for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+        if (::chmod(it->path.c_str(), static_cast<mode_t>(it->data->getOctalPermissions())) != 0) {
+            error = describe("cannot set mode of", it->path, errno);
+            return false;
+        }
+        if (!setTimes(it->path, it->data->getModifiedTime(), error)) {
+            return false;
+        }
+    }
+
+    stats.directories = directories.size();
+    stats.files = jobs.size();
+    stats.links = links.size();
+    for (const FileJob& job : jobs) {
+        stats.bytes += job.size;
+    }
+    stats.threads = threads;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_EXPORT_H
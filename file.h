@@ -1,249 +1,332 @@
-#ifndef LINUX_EMULATOR_FILE_H
-#define LINUX_EMULATOR_FILE_H
-
-#include <string>
-#include <vector>
-#include <bitset>
-#include <iomanip>
-#include <sstream>
-
-namespace LinuxEmulator {
-
-enum class Permission {
-    None = 0,
-    OthersExecute = 1,      
-    OthersWrite = 2,        
-    OthersRead = 4,         
-    GroupExecute = 8,       
-    GroupWrite = 16,        
-    GroupRead = 32,         
-    OwnerExecute = 64,      
-    OwnerWrite = 128,       
-    OwnerRead = 256        
-};
-
-inline bool operator&(Permission lhs, Permission rhs) {
-    using T = std::underlying_type_t<Permission>;
-    return static_cast<T>(lhs) & static_cast<T>(rhs);
-}
-
-inline Permission& operator|=(Permission& lhs, Permission rhs) {
-    using T = std::underlying_type_t<Permission>;
-    lhs = static_cast<Permission>(static_cast<T>(lhs) | static_cast<T>(rhs));
-    return lhs;
-}
-
-constexpr Permission operator|(Permission a, Permission b) {
-    return static_cast<Permission>(static_cast<int>(a) | static_cast<int>(b));
-}
-
-class File {
-public:
-    File();
-    File(const std::string&);
-    File(const std::string&, const std::string&, char*, const std::string&, const Permission&, bool);
-    File& operator=(const File&);
-    File(const File&);
-    ~File();
-    void setName(const std::string&);
-    std::string getName() const;
-    void setAbsolutePath(const std::string&);
-    std::string getAbsolutePath() const;
-    void setContent(const char*);
-    char* getContent() const;
-    void setFormat(const std::string&);
-    std::string getFormat() const;
-    int getOctalPermissions() const;
-    std::string getPermissionsString() const;
-    void setPermissions(bool, bool, bool, bool, bool, bool, bool, bool, bool);
-    void setPermissionsFromOctal(int);
-    void setPermissions(Permission);
-    Permission getPermissions() const;
-    void setIsDirectory(bool);
-    bool getIsDirectory() const;
-private:
-    std::string name;
-    std::string absolutePath;
-    char* content;
-    std::string format;
-    Permission permissions;
-    bool is_Directory;
-};
-
-File::File() = default;
-
-File::File(const std::string& n) : name{n} {}
-
-File::File(const std::string& n, const std::string& p, char* c, const std::string& f, const Permission& per, bool is_d)
-    : name{n}, absolutePath{p}, content{nullptr}, format{f}, permissions{per}, is_Directory{is_d} 
-{
-    if (content != nullptr) {
-        this->content = new char[strlen(content) + 1];
-        strcpy(this->content, content);
-    }
-}
-
-File::File(const File& other) : name(other.name), absolutePath(other.absolutePath), content(nullptr), format(other.format), 
-    permissions(other.permissions), is_Directory(other.is_Directory) 
-{
-    if (other.content != nullptr) {
-        this->content = new char[strlen(other.content) + 1];
-        strcpy(this->content, other.content);
-    }
-}
-
-File& File::operator=(const File& other) {
-    if (this == &other) {
-        return *this;
-    }
-    delete[] content;
-    content = nullptr;
-    name = other.name;
-    absolutePath = other.absolutePath;
-    format = other.format;
-    permissions = other.permissions;
-    is_Directory = other.is_Directory;
-    if (other.content != nullptr) {
-        this->content = new char[strlen(other.content) + 1];
-        strcpy(this->content, other.content);
-    }
-    return *this;
-}
-
-File::~File() {
-    delete[] content;
-}
-
-void File::setName(const std::string& n) {
-    name = n;
-}
-
-std::string File::getName() const {
-    return name;
-}
-
-void File::setAbsolutePath(const std::string& p) {
-    absolutePath = p;
-}
-
-std::string File::getAbsolutePath() const {
-    return absolutePath;
-}
-
-void File::setContent(const char* c) {
-    delete[] content;
-    if (c != nullptr) {
-        content = new char[strlen(c) + 1];
-        strcpy(content, c);
-    } else {
-        content = nullptr;
-    }
-}
-
-char* File::getContent() const {
-    return content;
-}
-
-void File::setFormat(const std::string& f) {
-    format = f;
-}
-
-std::string File::getFormat() const {
-    return format;
-}
-
-Permission File::getPermissions() const {
-	return permissions;
-}
-
-void File::setPermissions(bool ownerRead, bool ownerWrite, bool ownerExecute,
-    bool groupRead, bool groupWrite, bool groupExecute,
-    bool othersRead, bool othersWrite, bool othersExecute) {
-    permissions = Permission::None;
-
-    if (ownerRead) permissions |= Permission::OwnerRead;
-    if (ownerWrite) permissions |= Permission::OwnerWrite;
-    if (ownerExecute) permissions |= Permission::OwnerExecute;
-    if (groupRead) permissions |= Permission::GroupRead;
-    if (groupWrite) permissions |= Permission::GroupWrite;
-    if (groupExecute) permissions |= Permission::GroupExecute;
-    if (othersRead) permissions |= Permission::OthersRead;
-    if (othersWrite) permissions |= Permission::OthersWrite;
-    if (othersExecute) permissions |= Permission::OthersExecute;
-}
-
-void File::setPermissions(Permission permissions) {
-    this->permissions = permissions;
-}
-
-void File::setPermissionsFromOctal(int octal) {
-    permissions = static_cast<Permission>(octal);
-}
-
-int File::getOctalPermissions() const {
-    return static_cast<int>(permissions);
-}
-
-std::string File::getPermissionsString() const {
-    const std::string permSymbols = "rwx";
-    std::ostringstream permissionStr;
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerRead))
-        permissionStr << permSymbols[0];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerWrite))
-        permissionStr << permSymbols[1];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerExecute))
-        permissionStr << permSymbols[2];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupRead))
-        permissionStr << permSymbols[0];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupWrite))
-        permissionStr << permSymbols[1];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupExecute))
-        permissionStr << permSymbols[2];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersRead))
-        permissionStr << permSymbols[0];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersWrite))
-        permissionStr << permSymbols[1];
-    else
-        permissionStr << '-';
-
-    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersExecute))
-        permissionStr << permSymbols[2];
-    else
-        permissionStr << '-';
-
-    return permissionStr.str();
-}
-
-void File::setIsDirectory(bool i) {
-    is_Directory = i;
-}
-
-bool File::getIsDirectory() const {
-    return is_Directory;
-}
-
-} // namespace LinuxEmulator
-
+#ifndef LINUX_EMULATOR_FILE_H
+#define LINUX_EMULATOR_FILE_H
+
+#include <string>
+#include <vector>
+#include <bitset>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+#include "hash.h"
+#include "buffer.h"
+
+namespace LinuxEmulator {
+
+enum class Permission {
+    None = 0,
+    OthersExecute = 1,      
+    OthersWrite = 2,        
+    OthersRead = 4,         
+    GroupExecute = 8,       
+    GroupWrite = 16,        
+    GroupRead = 32,         
+    OwnerExecute = 64,      
+    OwnerWrite = 128,       
+    OwnerRead = 256        
+};
+
+inline bool operator&(Permission lhs, Permission rhs) {
+    using T = std::underlying_type_t<Permission>;
+    return static_cast<T>(lhs) & static_cast<T>(rhs);
+}
+
+inline Permission& operator|=(Permission& lhs, Permission rhs) {
+    using T = std::underlying_type_t<Permission>;
+    lhs = static_cast<Permission>(static_cast<T>(lhs) | static_cast<T>(rhs));
+    return lhs;
+}
+
+constexpr Permission operator|(Permission a, Permission b) {
+    return static_cast<Permission>(static_cast<int>(a) | static_cast<int>(b));
+}
+
+// Inode record: everything about a file except its name(s). Directory
+// entries (Node) refer to a File, and several entries may share one.
+// linkCount is the st_nlink seen by the tree that owns the record, while
+// referenceCount counts every entry pointing here, including entries that are
+// only reachable from snapshots, and decides when the record is freed.
+// Permission and type bits are packed into a single 16-bit mode word laid out
+// like st_mode, and the remaining metadata uses fixed-width fields so that a
+// record fits in one 64-byte slab block.
+class File {
+public:
+    static const std::uint16_t permissionMask = 0777;
+    static const std::uint16_t typeDirectory = 0040000;
+    static const std::uint16_t typeRegular = 0100000;
+    File();
+    File(const char*, const Permission&, bool);
+    File(std::string_view, const Permission&, bool);
+    File(const File&);
+    File(File&&) noexcept;
+    File& operator=(const File&);
+    File& operator=(File&&) noexcept;
+    ~File();
+    void setContent(std::string_view);
+    void setContent(ContentBuffer&&);
+    void appendContent(std::string_view);
+    void shareContent(const File&);
+    void internContent(BlobStore&);
+    const ContentBuffer& getContent() const;
+    std::uint64_t getSize() const;
+    int getOctalPermissions() const;
+    std::string getPermissionsString() const;
+    void setPermissions(bool, bool, bool, bool, bool, bool, bool, bool, bool);
+    void setPermissionsFromOctal(int);
+    void setPermissions(Permission);
+    Permission getPermissions() const;
+    void setIsDirectory(bool);
+    bool getIsDirectory() const;
+    std::uint16_t getMode() const;
+    void setOwner(std::uint32_t, std::uint32_t);
+    std::uint32_t getOwnerId() const;
+    std::uint32_t getGroupId() const;
+    std::time_t getModifiedTime() const;
+    std::time_t getChangeTime() const;
+    void setInodeNumber(unsigned long);
+    unsigned long getInodeNumber() const;
+    void setLinkCount(int);
+    int getLinkCount() const;
+    void setReferenceCount(std::uint32_t);
+    std::uint32_t getReferenceCount() const;
+    std::uint64_t getHash() const;
+private:
+    friend class TreeImage;
+    void touch();
+    ContentBuffer content;
+    std::uint64_t contentHash;
+    std::int64_t modifiedTime;
+    std::int64_t changeTime;
+    std::uint32_t inodeNumber;
+    std::uint32_t linkCount;
+    std::uint32_t referenceCount;
+    std::uint32_t ownerId;
+    std::uint32_t groupId;
+    std::uint16_t mode;
+};
+
+File::File() : contentHash{hashBytes(nullptr, 0)}, modifiedTime{0}, changeTime{0}, inodeNumber{0}, linkCount{0}, 
+    referenceCount{0}, ownerId{0}, groupId{0}, mode{typeRegular} {}
+
+File::File(const char* c, const Permission& per, bool is_d) 
+    : File(c == nullptr ? std::string_view() : std::string_view(c), per, is_d) {}
+
+File::File(std::string_view c, const Permission& per, bool is_d)
+    : content{c}, contentHash{hashBytes(c.data(), c.size())}, modifiedTime{std::time(nullptr)}, changeTime{modifiedTime}, 
+      inodeNumber{0}, linkCount{0}, referenceCount{0}, ownerId{0}, groupId{0}, 
+      mode{static_cast<std::uint16_t>((is_d ? typeDirectory : typeRegular) | (static_cast<int>(per) & permissionMask))} {}
+
+File::File(const File& other) = default;
+
+File::File(File&& other) noexcept = default;
+
+File& File::operator=(const File& other) = default;
+
+File& File::operator=(File&& other) noexcept = default;
+
+File::~File() = default;
+
+void File::touch() {
+    modifiedTime = std::time(nullptr);
+    changeTime = modifiedTime;
+}
+
+void File::setContent(std::string_view c) {
+    content.assign(c);
+    contentHash = hashBytes(c.data(), c.size());
+    touch();
+}
+
+void File::setContent(ContentBuffer&& c) {
+    content = std::move(c);
+    contentHash = hashBytes(nullptr, 0);
+    for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+        contentHash = hashBytes(content.chunk(i).data(), content.chunk(i).size(), contentHash);
+    }
+    touch();
+}
+
+// Only the new bytes are copied and hashed.
+void File::appendContent(std::string_view c) {
+    content.append(c);
+    contentHash = hashBytes(c.data(), c.size(), contentHash);
+    touch();
+}
+
+// Takes other's content without copying it, like a reflink; the first write
+// to either file gives it its own copy.
+void File::shareContent(const File& other) {
+    content = other.content;
+    contentHash = other.contentHash;
+    touch();
+}
+
+void File::internContent(BlobStore& store) {
+    store.intern(content, contentHash);
+}
+
+const ContentBuffer& File::getContent() const {
+    return content;
+}
+
+std::uint64_t File::getSize() const {
+    return content.size();
+}
+
+Permission File::getPermissions() const {
+	return static_cast<Permission>(mode & permissionMask);
+}
+
+void File::setPermissions(bool ownerRead, bool ownerWrite, bool ownerExecute,
+    bool groupRead, bool groupWrite, bool groupExecute,
+    bool othersRead, bool othersWrite, bool othersExecute) {
+    Permission permissions = Permission::None;
+
+    if (ownerRead) permissions |= Permission::OwnerRead;
+    if (ownerWrite) permissions |= Permission::OwnerWrite;
+    if (ownerExecute) permissions |= Permission::OwnerExecute;
+    if (groupRead) permissions |= Permission::GroupRead;
+    if (groupWrite) permissions |= Permission::GroupWrite;
+    if (groupExecute) permissions |= Permission::GroupExecute;
+    if (othersRead) permissions |= Permission::OthersRead;
+    if (othersWrite) permissions |= Permission::OthersWrite;
+    if (othersExecute) permissions |= Permission::OthersExecute;
+    setPermissions(permissions);
+}
+
+void File::setPermissions(Permission permissions) {
+    setPermissionsFromOctal(static_cast<int>(permissions));
+}
+
+void File::setPermissionsFromOctal(int octal) {
+    mode = static_cast<std::uint16_t>((mode & ~permissionMask) | (octal & permissionMask));
+    changeTime = std::time(nullptr);
+}
+
+int File::getOctalPermissions() const {
+    return mode & permissionMask;
+}
+
+std::string File::getPermissionsString() const {
+    const std::string permSymbols = "rwx";
+    Permission permissions = getPermissions();
+    std::ostringstream permissionStr;
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerRead))
+        permissionStr << permSymbols[0];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerWrite))
+        permissionStr << permSymbols[1];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OwnerExecute))
+        permissionStr << permSymbols[2];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupRead))
+        permissionStr << permSymbols[0];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupWrite))
+        permissionStr << permSymbols[1];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::GroupExecute))
+        permissionStr << permSymbols[2];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersRead))
+        permissionStr << permSymbols[0];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersWrite))
+        permissionStr << permSymbols[1];
+    else
+        permissionStr << '-';
+
+    if (static_cast<int>(permissions) & static_cast<int>(Permission::OthersExecute))
+        permissionStr << permSymbols[2];
+    else
+        permissionStr << '-';
+
+    return permissionStr.str();
+}
+
+void File::setIsDirectory(bool i) {
+    mode = static_cast<std::uint16_t>((mode & permissionMask) | (i ? typeDirectory : typeRegular));
+}
+
+bool File::getIsDirectory() const {
+    return (mode & typeDirectory) != 0;
+}
+
+std::uint16_t File::getMode() const {
+    return mode;
+}
+
+void File::setOwner(std::uint32_t uid, std::uint32_t gid) {
+    ownerId = uid;
+    groupId = gid;
+    changeTime = std::time(nullptr);
+}
+
+std::uint32_t File::getOwnerId() const {
+    return ownerId;
+}
+
+std::uint32_t File::getGroupId() const {
+    return groupId;
+}
+
+std::time_t File::getModifiedTime() const {
+    return static_cast<std::time_t>(modifiedTime);
+}
+
+std::time_t File::getChangeTime() const {
+    return static_cast<std::time_t>(changeTime);
+}
+
+void File::setInodeNumber(unsigned long n) {
+    inodeNumber = static_cast<std::uint32_t>(n);
+}
+
+unsigned long File::getInodeNumber() const {
+    return inodeNumber;
+}
+
+void File::setLinkCount(int l) {
+    linkCount = static_cast<std::uint32_t>(l);
+}
+
+int File::getLinkCount() const {
+    return static_cast<int>(linkCount);
+}
+
+void File::setReferenceCount(std::uint32_t r) {
+    referenceCount = r;
+}
+
+std::uint32_t File::getReferenceCount() const {
+    return referenceCount;
+}
+
+// Fingerprint of what an exam compares: type, permission bits and content.
+// Timestamps, owners and link counts are left out.
+std::uint64_t File::getHash() const {
+    return mixHash(contentHash ^ (static_cast<std::uint64_t>(mode) << 48));
+}
+
+} // namespace LinuxEmulator
+
 #endif // LINUX_EMULATOR_FILE_H
\ No newline at end of file
@@ -1,675 +1,1402 @@
-#ifndef LINUX_EMULATOR_FILESYSTEM_H
-#define LINUX_EMULATOR_FILESYSTEM_H
-
-#include "gtree.h"
-#include "commandvalidator.h"
-
-#include <iostream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <ctime>
-
-namespace LinuxEmulator {
-
-class FileSystem {
-public:
-    FileSystem();
-    void help();
-    void pwd();
-    void ls();
-    void lsDetailed();
-    void lsSortedByTime();
-    void lsLongFormat();
-    void cd(const std::string&);
-    void createFile(const std::string&);
-    void createDirectory(const std::string&);
-    void readFile(const std::string&);
-    void writeFile(const std::string&);
-    void copyFile(const std::string&, const std::string&);
-    void moveFile(const std::string&, const std::string&);
-    void renameItem(const std::string&, const std::string&);
-    void deleteFile(const std::string&);
-    void updateChildPaths(Node*, const std::string&, const std::string&);
-    Node* findNode(const std::string&) const;
-    std::string getCurrentDirectory() const;
-    void setCurrentDirectory(const std::string&);
-    void chmod(const std::string&, const std::string&);
-    void addToHistory(const std::string&);
-    void clearCommandHistory();
-    std::vector<std::string> getCommandHistory() const;
-    void history();
-    void clear();
-    void head(int, const std::string&);
-    void tail(int, const std::string&);
-    void file(const std::string&);
-    void ln(const std::string&, const std::string&);
-    void wc(const std::string&);
-    bool operator==(const FileSystem& other) const {
-        return getCurrentDirectory() == other.getCurrentDirectory() && tree == other.tree;
-    }
-    std::string getFullPath(Node*);
-    void deleteDirectoryContents(Node*);
-private:
-    GeneralTree tree;
-    std::string currentDirectory;
-    std::vector<std::string> commandHistory;
-    std::string previousDirectory;
-};
-
-std::vector<std::string> splitPath(const std::string& path) {
-    std::vector<std::string> components;
-    std::string component;
-    std::istringstream iss(path);
-    while (std::getline(iss, component, '/')) {
-        if (!component.empty()) {
-            components.push_back(component);
-        }
-    }
-    return components;
-}
-
-FileSystem::FileSystem() {
-    File rootFile("/", "/", nullptr, "", Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
-                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
-                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, 
-                  true);
-    Node* rootNode = new Node(rootFile);
-    rootNode->parent = nullptr;
-    tree.setRootData(rootFile);
-    tree.setRoot(rootNode);
-    currentDirectory = "/";
-    previousDirectory = "/";
-}
-
-void FileSystem::addToHistory(const std::string& command) {
-    std::string commandToAdd = command;
-    commandToAdd.erase(std::remove(commandToAdd.begin(), commandToAdd.end(), '\n'), commandToAdd.end());
-    commandHistory.push_back(commandToAdd);
-}
-
-void FileSystem::clearCommandHistory() {
-    commandHistory.clear();
-}
-
-std::vector<std::string> FileSystem::getCommandHistory() const {
-    return commandHistory;
-}
-
-void FileSystem::history() {
-    for (int i = 0; i < commandHistory.size(); ++i) {
-        std::cout << commandHistory[i] << std::endl;
-    }
-}
-
-void FileSystem::file(const std::string& fileName) {
-    int index = 0;
-    for (int i = 0; i < fileName.size(); ++i) {
-        if (fileName[i] == '.') {
-            index = i;
-        }
-    }
-    std::string format = fileName.substr(index + 1);
-    std::cout << fileName << ": " << format << " file" << std::endl;
-}
-
-void FileSystem::ln(const std::string& source, const std::string& destination) {
-    Node* sourceNode = findNode(source);
-    Node* destinationNode = findNode(destination);
-    
-    if (sourceNode == nullptr) {
-        std::cout << "Source item not found: " << source << std::endl;
-        return;
-    }
-    
-    if (destinationNode != nullptr) {
-        std::cout << "Destination item already exists: " << destination << std::endl;
-        return;
-    }
-
-    if (sourceNode->data.getIsDirectory()) {
-        createDirectory(destination);
-    }
-    else {
-        createFile(destination);
-    }
-}
-
-void FileSystem::wc(const std::string& fileName) {
-    Node* fileNode = findNode(fileName);
-    if (!fileNode) {
-        std::cout << "File not found: " << fileName << std::endl;
-        return;
-    }
-    const std::string& content = fileNode->data.getContent();
-    int lineCount = 0;
-    int wordCount = 0;
-    int charCount = 0;
-    std::istringstream iss(content);
-    std::string word;
-    std::string line; 
-    while (std::getline(iss, line)) {
-        ++lineCount;
-        std::istringstream lineIss(line);   
-        while (lineIss >> word) {
-            ++wordCount;
-            charCount += word.length();
-        }
-    }
-    std::cout << "Lines: " << lineCount << std::endl;
-    std::cout << "Words: " << wordCount << std::endl;
-    std::cout << "Characters: " << charCount << std::endl;
-}
-
-void FileSystem::clear() {
-    std::cout << "\033[2J\033[1;1H";
-}
-
-void FileSystem::head(int numLines, const std::string& fileName) {
-    Node* fileNode = findNode(fileName);
-    if (fileNode == nullptr) {
-        std::string currentDirectory = getCurrentDirectory();
-        std::string filePath = currentDirectory + "/" + fileName;
-        fileNode = findNode(filePath);
-    }
-    if (fileNode == nullptr || fileNode->data.getIsDirectory()) {
-        std::cout << "File not found or the provided path is a directory." << std::endl;
-        return;
-    }
-    std::string content = fileNode->data.getContent();
-    std::vector<std::string> lines;
-    std::istringstream iss(content);
-    std::string line;
-    while (std::getline(iss, line)) {
-        lines.push_back(line);
-    }
-
-    int linesToPrint = std::min(numLines, static_cast<int>(lines.size()));
-    for (int i = 0; i < linesToPrint; ++i) {
-        std::cout << lines[i] << std::endl;
-    }
-}
-
-void FileSystem::tail(int numLines, const std::string& fileName) {
-    Node* fileNode = findNode(fileName);
-    if (fileNode == nullptr) {
-        std::string currentDirectory = getCurrentDirectory();
-        std::string filePath = currentDirectory + "/" + fileName;
-        fileNode = findNode(filePath);
-    }
-    if (fileNode == nullptr || fileNode->data.getIsDirectory()) {
-        std::cout << "File not found or the provided path is a directory." << std::endl;
-        return;
-    }
-
-    std::string content = fileNode->data.getContent();
-    std::vector<std::string> lines;
-    std::istringstream iss(content);
-    std::string line;
-    while (std::getline(iss, line)) {
-        lines.push_back(line);
-    }
-
-    int startLine = std::max(static_cast<int>(lines.size()) - numLines, 0);
-    for (int i = startLine; i < lines.size(); ++i) {
-        std::cout << lines[i] << std::endl;
-    }
-}
-
-void FileSystem::chmod(const std::string& permissions, const std::string& filePath) {
-    Node* fileNode = findNode(filePath);
-    if (fileNode == nullptr) {
-        std::cout << "File not found: " << filePath << std::endl;
-        return;
-    }
-    int octalPermissions = std::stoi(permissions, 0, 8);
-    fileNode->data.setPermissionsFromOctal(octalPermissions);
-}
-
-std::string FileSystem::getCurrentDirectory() const {
-    return currentDirectory;
-}
-
-void FileSystem::setCurrentDirectory(const std::string& c) {
-    currentDirectory = c;
-}
-
-std::string normalizePath(const std::string& path) {
-    if (path.empty() || path == "/") {
-        return "/";
-    }
-
-    std::stringstream ss(path);
-    std::string item;
-    std::vector<std::string> parts;
-
-    while (std::getline(ss, item, '/')) {
-        if (item == "..") {
-            if (!parts.empty()) {
-                parts.pop_back();
-            }
-        } else if (item != ".") {
-            parts.push_back(item);
-        }
-    }
-
-    std::string normalized;
-    for (const auto& part : parts) {
-        normalized += "/" + part;
-    }
-
-    if (normalized.empty()) {
-        normalized = "/";
-    }
-
-    return normalized;
-}
-
-Node* findChildNode(Node* parent, const std::string& name) {
-    for (Node* child : parent->children) {
-        if (child->data.getName() == name) {
-            return child;
-        }
-    }
-    return nullptr; 
-}
-
-Node* FileSystem::findNode(const std::string& path) const {
-    std::string normalizedPath = normalizePath(path);
-    std::vector<std::string> parts = splitPath(normalizedPath);
-
-    Node* currentNode = tree.getRoot();
-    for (const auto& part : parts) {
-        currentNode = findChildNode(currentNode, part);
-        if (currentNode == nullptr) {
-            return nullptr; // Path not found
-        }
-    }
-    return currentNode;
-}
-
-std::string FileSystem::getFullPath(Node* node) {
-    if (node == tree.getRoot()) {
-        return "/";
-    }
-
-    std::vector<std::string> dirs;
-    Node* currentNode = node;
-    while (currentNode != tree.getRoot()) {
-        dirs.push_back(currentNode->data.getName());
-        currentNode = currentNode->parent;
-    }
-
-    std::string fullPath;
-    for (auto it = dirs.rbegin(); it != dirs.rend(); ++it) {
-        fullPath += "/";
-        fullPath += *it;
-    }
-    return fullPath;
-}
-
-void FileSystem::pwd() {
-    std::string fullPath = getFullPath(findNode(currentDirectory));
-    std::cout << fullPath << std::endl;
-}
-
-void FileSystem::help() {
-    CommandValidator cv;
-    for (const auto& option : cv.getValidOptions()) {
-        std::cout << option.first << ": ";
-        for (const auto& value : option.second) {
-            std::cout << value << " ";
-        }
-        std::cout << std::endl;
-    }
-}
-
-void FileSystem::cd(const std::string& directoryPath) {
-    std::string newPath = directoryPath;
-    std::string homeDirectory = "/home/username";
-    if (newPath == "~") {
-        newPath = homeDirectory;
-    } else if (newPath == "-") {
-        std::swap(currentDirectory, previousDirectory); // Swap current and previous directories
-        std::cout << "Current directory changed to: " << currentDirectory << std::endl;
-        return;
-    } else if (newPath == "..") {
-        size_t lastSlashIndex = currentDirectory.find_last_of('/');
-        if (lastSlashIndex != std::string::npos) {
-            newPath = currentDirectory.substr(0, lastSlashIndex);
-        } else {
-            std::cout << "Error: Cannot go up from root directory." << std::endl;
-            return;
-        }
-    } else if (newPath == ".") {
-        return;
-    }
-    Node* directoryNode = findNode(newPath);
-    if (directoryNode == nullptr) {
-        std::cout << "No such file or directory." << std::endl;
-        return;
-    }
-    if (!directoryNode->data.getIsDirectory()) {
-        std::cout << "Error: Not a directory." << std::endl;
-        return;
-    }
-    previousDirectory = currentDirectory;
-    currentDirectory = newPath;
-    std::cout << "Current directory changed to: " << currentDirectory << std::endl;
-}
-
-void FileSystem::createFile(const std::string& filePath) {
-    if (filePath.empty()) {
-        std::cout << "Invalid file path. Please provide a valid file path or filename." << std::endl;
-        return;
-    }
-    std::size_t found = filePath.find_last_of("/");
-    std::string directoryPath;
-    std::string fileName;
-    if (found != std::string::npos) {
-        directoryPath = filePath.substr(0, found);
-        fileName = filePath.substr(found + 1);
-    } else {
-        directoryPath = currentDirectory;
-        fileName = filePath;
-    }
-
-    Node* parentNode = findNode(directoryPath);
-    if (parentNode == nullptr) {
-        std::cout << "Directory does not exist. File creation failed." << std::endl;
-        return;
-    }
-    for (const auto& child : parentNode->children) {
-        if (child->data.getName() == fileName && !child->data.getIsDirectory()) {
-            std::cout << "File with the same name already exists in the directory. File creation failed." << std::endl;
-            return;
-        }
-    }
-    File file(fileName, filePath, nullptr, "", Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
-                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
-                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, false);
-    tree.insert(parentNode->data, file);
-}
-
-void FileSystem::createDirectory(const std::string& directoryName) {
-    std::string currentPath = currentDirectory;
-    std::size_t slashPos = directoryName.find('/');
-    if (slashPos != std::string::npos) {
-        std::string path = directoryName.substr(0, slashPos);
-        std::string name = directoryName.substr(slashPos + 1);
-        currentPath += "/" + path;
-        Node* parentNode = findNode(currentPath);
-        if (parentNode == nullptr || !parentNode->data.getIsDirectory()) {
-            std::cout << "Parent directory does not exist." << std::endl;
-            return;
-        }
-        File newDirectory(name, currentPath + "/" + name, nullptr, "", Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
-                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
-                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, true);
-        Node* newDirectoryNode = new Node(newDirectory);
-        tree.insert(parentNode, newDirectoryNode);
-        std::cout << "Directory created successfully." << std::endl;
-    } else {
-        std::string parentDirectoryPath = currentPath + "/" + directoryName;
-        Node* parentDirectoryNode = findNode(parentDirectoryPath);
-        if (parentDirectoryNode != nullptr) {
-            std::cout << "Directory already exists." << std::endl;
-            return;
-        }
-        File newDirectory(directoryName, parentDirectoryPath, nullptr, "", Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
-                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
-                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, true);
-        Node* parentNode = findNode(currentPath);
-        if (parentNode == nullptr || !parentNode->data.getIsDirectory()) {
-            std::cout << "Parent directory does not exist." << std::endl;
-            return;
-        }
-        Node* newDirectoryNode = new Node(newDirectory);
-        tree.insert(parentNode, newDirectoryNode);
-        std::cout << "Created" << std::endl;
-    }
-}
-
-void FileSystem::readFile(const std::string& fileName) {
-    Node* fileNode = findNode(fileName);
-    if (fileNode == nullptr) {
-        std::string currentDirectory = getCurrentDirectory();
-        std::string filePath = currentDirectory + "/" + fileName;
-        fileNode = findNode(filePath);
-    }
-    if (fileNode == nullptr || fileNode->data.getIsDirectory()) {
-        std::cout << "File not found or the provided path is a directory." << std::endl;
-        return;
-    }
-    std::cout << fileNode->data.getContent() << std::endl;
-}
-
-void FileSystem::writeFile(const std::string& fileName) {
-    std::cout << "If you end typing press !q" << std::endl;
-    Node* fileNode = findNode(fileName);
-    if (fileNode == nullptr) {
-        std::string currentDirectory = getCurrentDirectory();
-        std::string filePath = currentDirectory + "/" + fileName;
-        fileNode = findNode(filePath);
-    }
-    if (fileNode == nullptr || fileNode->data.getIsDirectory()) {
-        std::cout << "File not found or the provided path is a directory." << std::endl;
-        return;
-    }
-    std::string input;
-    std::ostringstream contentStream;
-    while (getline(std::cin, input) && input != "!q") {
-        contentStream << input << '\n';
-    }
-    std::string content = contentStream.str();
-    fileNode->data.setContent(content.c_str());
-}
-
-void FileSystem::copyFile(const std::string& source, const std::string& destination) {
-    Node* sourceNode = findNode(source);
-    Node* destinationNode = findNode(destination);
-
-    if (sourceNode == nullptr) {
-        std::string sourcePath = getCurrentDirectory() + "/" + source;
-        sourceNode = findNode(sourcePath);
-    }
-    if (sourceNode == nullptr) {
-        std::cout << "Source path not found." << std::endl;
-        return;
-    }
-    if (destinationNode != nullptr) {
-        std::cout << "Destination path already exists." << std::endl;
-        return;
-    }
-    std::size_t found = destination.find_last_of("/");
-    if (found == std::string::npos) {
-        std::cout << "Invalid destination path. Please provide the full path including the directory." << std::endl;
-        return;
-    }
-    std::string destinationDirectory = destination.substr(0, found);
-    std::string destinationName = destination.substr(found + 1);
-    Node* destinationParentNode = findNode(destinationDirectory);
-    if (destinationParentNode == nullptr) {
-        std::cout << "Destination directory does not exist." << std::endl;
-        return;
-    }
-    Permission permissions = Permission::OwnerRead | Permission::OwnerWrite | Permission::GroupRead | Permission::OthersRead;
-    destinationNode = new Node(File(destinationName, destination, sourceNode->data.getContent(), sourceNode->data.getFormat(), permissions, false));
-    destinationParentNode->addChild(destinationNode);
-    std::cout << "File copied successfully." << std::endl;
-}
-
-
-void FileSystem::moveFile(const std::string& source, const std::string& destination) {
-    Node* sourceNode = findNode(source);
-    Node* destinationNode = findNode(destination);
-    if (sourceNode == nullptr) {
-        std::cout << "Source path not found." << std::endl;
-        return;
-    }
-    if (destinationNode != nullptr && destinationNode->data.getIsDirectory()) {
-        std::string destinationPath = destination + "/" + sourceNode->data.getName();
-        sourceNode->data.setAbsolutePath(destinationPath);
-        if (sourceNode->parent != nullptr) {
-            sourceNode->parent->removeChild(sourceNode); // Remove from the previous parent
-        }
-        destinationNode->addChild(sourceNode);
-        sourceNode->parent = destinationNode;
-        std::cout << "File or directory moved successfully." << std::endl;
-    } else {
-        std::size_t found = destination.find_last_of("/");
-        if (found == std::string::npos) {
-            std::cout << "Invalid destination path. Please provide the full path including the directory." << std::endl;
-            return;
-        }
-        std::string destinationDirectory = destination.substr(0, found);
-        std::string destinationName = destination.substr(found + 1);
-        Node* destinationParentNode = findNode(destinationDirectory);
-        if (destinationParentNode == nullptr || !destinationParentNode->data.getIsDirectory()) {
-            std::cout << "Destination directory does not exist." << std::endl;
-            return;
-        }
-        Node* existingNode = findNode(destination);
-        if (existingNode != nullptr) {
-            std::cout << "A file or directory already exists at the destination path." << std::endl;
-            return;
-        }
-        sourceNode->data.setName(destinationName);
-        sourceNode->data.setAbsolutePath(destination);
-        if (sourceNode->parent != nullptr) {
-            sourceNode->parent->removeChild(sourceNode); // Remove from the previous parent
-        }
-        destinationParentNode->addChild(sourceNode);
-        sourceNode->parent = destinationParentNode;
-        std::cout << "File or directory moved successfully." << std::endl;
-        if (sourceNode->parent != destinationParentNode) {
-            sourceNode->parent->removeChild(sourceNode); // Remove from the source parent
-        }
-    }
-}
-
-void FileSystem::renameItem(const std::string& itemPath, const std::string& newName) {
-    Node* itemNode = findNode(itemPath);
-    if (itemNode == nullptr) {
-        std::cout << "Item not found." << std::endl;
-        return;
-    }
-    std::string parentPath = itemNode->data.getAbsolutePath();
-    std::size_t found = parentPath.find_last_of("/");
-    std::string newPath = parentPath.substr(0, found + 1) + newName;
-    itemNode->data.setName(newName);
-    itemNode->data.setAbsolutePath(newPath);
-    std::cout << "Item renamed successfully." << std::endl;
-}
-
-void FileSystem::deleteFile(const std::string& filePath) {
-    Node* fileNode = findNode(filePath);
-    if (fileNode == nullptr) {
-        std::cout << "File or directory not found." << std::endl;
-        return;
-    }
-    if (fileNode->data.getIsDirectory()) {
-        deleteDirectoryContents(fileNode);
-    }
-    tree.remove(fileNode);
-    std::cout << "File or directory deleted successfully." << std::endl;
-}
-
-void FileSystem::deleteDirectoryContents(Node* directoryNode) {
-    for (Node* child : directoryNode->children) {
-        if (child->data.getIsDirectory()) {
-            deleteDirectoryContents(child);
-        }
-        tree.remove(child);
-    }
-}
-
-void printColoredText(const std::string& text, int colorCode) {
-    std::cout << "\033[" << colorCode << "m" << text << "\033[0m";
-}
-
-void FileSystem::ls() {
-    Node* currentNode = findNode(currentDirectory);
-    if (currentNode == nullptr || !currentNode->data.getIsDirectory()) {
-        std::cout << "Current directory not found." << std::endl;
-        return;
-    }
-    std::cout << "Listing directory: " << currentDirectory << std::endl;
-    for (Node* child : currentNode->children) {
-        if (child->data.getIsDirectory()) {
-            printColoredText(child->data.getName(), 34);
-            std::cout << std::endl;
-        }
-        else {
-            printColoredText(child->data.getName(), 32);
-            std::cout << std::endl;
-        }
-    }
-}
-
-void FileSystem::lsDetailed() {
-    Node* currentNode = findNode(currentDirectory);
-    if (currentNode == nullptr || !currentNode->data.getIsDirectory()) {
-        std::cout << "Current directory not found." << std::endl;
-        return;
-    }
-    std::cout << "Detailed listing of directory: " << currentDirectory << std::endl;
-    for (Node* child : currentNode->children) {
-        if (child->data.getIsDirectory()) {
-            printColoredText(child->data.getName(), 34);
-        }
-        else {
-            printColoredText(child->data.getName(), 32);
-        }
-        std::cout << " " << child->data.getPermissionsString();
-        std::cout << std::endl;
-    }
-}
-
-void FileSystem::lsSortedByTime() {
-    Node* currentNode = findNode(currentDirectory);
-    if (currentNode == nullptr || !currentNode->data.getIsDirectory()) {
-        std::cout << "Current directory not found." << std::endl;
-        return;
-    }
-    std::time_t currentTime = std::time(nullptr);
-    std::cout << "Listing directory sorted by time: " << currentDirectory << std::endl;
-    std::vector<Node*> sortedChildren = currentNode->children;
-    std::sort(sortedChildren.begin(), sortedChildren.end(), [](Node* a, Node* b) {
-        return a->data.getName() < b->data.getName();
-    });
-    for (Node* child : sortedChildren) {
-        if (child->data.getIsDirectory()) {
-            printColoredText(child->data.getName(), 34);
-            std::cout << " " << std::put_time(std::localtime(&currentTime), "%Y-%m-%d %H:%M:%S") << std::endl;
-        } else {
-            printColoredText(child->data.getName(), 32);
-            std::cout << " " << std::put_time(std::localtime(&currentTime), "%Y-%m-%d %H:%M:%S") << std::endl;
-        }
-    }
-}
-
-void FileSystem::lsLongFormat() {
-    Node* currentNode = findNode(currentDirectory);
-    if (currentNode == nullptr || !currentNode->data.getIsDirectory()) {
-        std::cout << "Current directory not found." << std::endl;
-        return;
-    }
-    std::cout << "Long format listing of directory: " << currentDirectory << std::endl;
-    for (Node* child : currentNode->children) {
-        std::cout << (child->data.getIsDirectory() ? "d" : "-");
-        std::cout << child->data.getPermissionsString() << " ";
-        if (child->data.getIsDirectory()) {
-            printColoredText(child->data.getName(), 34);
-            std::cout << std::endl;
-        }
-        else {
-            printColoredText(child->data.getName(), 32);
-            std::cout << std::endl;
-        }
-    }
-}
-
-} // namespace LinuxEmulator
-
+#ifndef LINUX_EMULATOR_FILESYSTEM_H
+#define LINUX_EMULATOR_FILESYSTEM_H
+
+#include "gtree.h"
+#include "pathcache.h"
+#include "commandvalidator.h"
+#include "textcount.h"
+#include "image.h"
+#include "export.h"
+#include "grep.h"
+#include "find.h"
+#include "reclaim.h"
+#include "sort.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ctime>
+#include <cmath>
+#include <cctype>
+#include <string_view>
+
+namespace LinuxEmulator {
+
+class FileSystem {
+public:
+    // Frozen copy of the tree and the working directories. Taking or restoring
+    // one is O(1); nodes are shared until either side modifies them.
+    struct Snapshot {
+        GeneralTree tree;
+        std::string currentDirectory;
+        std::string previousDirectory;
+    };
+    FileSystem();
+    void help();
+    void pwd();
+    void ls();
+    void lsDetailed();
+    void lsSortedByTime();
+    void lsLongFormat();
+    void cd(const std::string&);
+    void createFile(const std::string&);
+    void createDirectory(const std::string&);
+    void readFile(const std::string&);
+    std::string writeFile(const std::string&);
+    void echoToFile(const std::string&, const std::string&, bool);
+    void copyFile(const std::string&, const std::string&, bool, bool);
+    void moveFile(const std::string&, const std::string&);
+    void renameItem(const std::string&, const std::string&);
+    void deleteFile(const std::string&, bool, bool);
+    void removeDirectory(const std::string&);
+    Node* findNode(const std::string&) const;
+    std::string getCurrentDirectory() const;
+    void setCurrentDirectory(const std::string&);
+    void chmod(const std::string&, const std::string&);
+    void addToHistory(const std::string&);
+    void clearCommandHistory();
+    std::vector<std::string> getCommandHistory() const;
+    void history();
+    void clear();
+    void head(int, const std::string&);
+    void tail(int, const std::string&);
+    void headBytes(std::size_t, const std::string&);
+    void tailBytes(std::size_t, const std::string&);
+    void file(const std::string&);
+    void ln(const std::string&, const std::string&);
+    void wc(const std::vector<std::string>&, bool, bool, bool);
+    void grep(const std::string&, const std::vector<std::string>&, bool, Grep::Options);
+    void sort(const std::vector<std::string>&, const TextSort::Options&, const std::string&);
+    void uniq(const std::string&, bool, bool);
+    void find(const std::vector<std::string>&, TreeFind::Criteria, const std::string&);
+    void fsstat();
+    void du(const std::vector<std::string>&, int, bool);
+    void df(bool, bool);
+    void setCapacity(std::uint64_t);
+    void setDeferredReclaim(bool);
+    void reclaimStatus() const;
+    StorageLock lockStorage();
+    void setCompressionIdleTime(long);
+    void compressIdleContents();
+    bool saveImage(const std::string&, std::size_t&, std::string&);
+    bool loadImage(const std::string&, std::size_t&, std::string&);
+    bool exportTree(const std::string&, const std::string&, unsigned, TreeExport::Stats&, std::string&) const;
+    Snapshot takeSnapshot();
+    void restoreSnapshot(const Snapshot&);
+    bool operator==(const FileSystem& other) const {
+        return getCurrentDirectory() == other.getCurrentDirectory() && tree == other.tree;
+    }
+    std::vector<std::string> diff(const FileSystem&) const;
+    std::string getFullPath(Node*);
+private:
+    Node* findFileNode(const std::string&);
+    Node* writableNode(const std::string&);
+    File* writableData(Node*);
+    Node* outputNode(const std::string&);
+    void settleReclaimed();
+    void finishReclaiming();
+    GeneralTree tree;
+    mutable PathCache pathCache;
+    std::string currentDirectory;
+    std::vector<std::string> commandHistory;
+    std::string previousDirectory;
+    long compressionIdleTime;
+    std::time_t nextCompressionSweep;
+    std::uint64_t capacity;
+    std::shared_ptr<Reclaimer> reclaimer;
+};
+
+std::vector<std::string> splitPath(const std::string& path) {
+    std::vector<std::string> components;
+    std::string component;
+    std::istringstream iss(path);
+    while (std::getline(iss, component, '/')) {
+        if (!component.empty()) {
+            components.push_back(component);
+        }
+    }
+    return components;
+}
+
+// Sizes the way du -h and df -h print them: bytes below 1K, then one
+// decimal below 10 and whole numbers above, always rounded up.
+std::string humanSize(std::uint64_t bytes) {
+    const char units[] = "KMGTPE";
+    if (bytes < 1024) {
+        return std::to_string(bytes);
+    }
+    double value = static_cast<double>(bytes) / 1024;
+    std::size_t unit = 0;
+    // Rounding up can carry into the next unit, as in 1023.9M.
+    while (std::ceil(value) >= 1024 && unit + 2 < sizeof(units)) {
+        value /= 1024;
+        ++unit;
+    }
+    std::ostringstream out;
+    if (std::ceil(value * 10) < 100) {
+        out << std::fixed << std::setprecision(1) << std::ceil(value * 10) / 10;
+    } else {
+        out << static_cast<std::uint64_t>(std::ceil(value));
+    }
+    return out.str() + units[unit];
+}
+
+FileSystem::FileSystem() : compressionIdleTime{-1}, nextCompressionSweep{0}, capacity{1ULL << 30} {
+    File rootFile(nullptr, Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
+                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
+                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, 
+                  true);
+    Node* rootNode = tree.createNode("/", rootFile);
+    tree.setRoot(rootNode);
+    currentDirectory = "/";
+    previousDirectory = "/";
+}
+
+void FileSystem::addToHistory(const std::string& command) {
+    std::string commandToAdd = command;
+    commandToAdd.erase(std::remove(commandToAdd.begin(), commandToAdd.end(), '\n'), commandToAdd.end());
+    commandHistory.push_back(commandToAdd);
+}
+
+void FileSystem::clearCommandHistory() {
+    commandHistory.clear();
+}
+
+std::vector<std::string> FileSystem::getCommandHistory() const {
+    return commandHistory;
+}
+
+void FileSystem::history() {
+    for (int i = 0; i < commandHistory.size(); ++i) {
+        std::cout << commandHistory[i] << std::endl;
+    }
+}
+
+void FileSystem::file(const std::string& fileName) {
+    int index = 0;
+    for (int i = 0; i < fileName.size(); ++i) {
+        if (fileName[i] == '.') {
+            index = i;
+        }
+    }
+    std::string format = fileName.substr(index + 1);
+    std::cout << fileName << ": " << format << " file" << std::endl;
+}
+
+void FileSystem::ln(const std::string& source, const std::string& destination) {
+    std::string sourcePath = source;
+    Node* sourceNode = findNode(sourcePath);
+    if (sourceNode == nullptr) {
+        sourcePath = getCurrentDirectory() + "/" + source;
+        sourceNode = findNode(sourcePath);
+    }
+    if (sourceNode == nullptr) {
+        std::cout << "Source item not found: " << source << std::endl;
+        return;
+    }
+    if (sourceNode->data->getIsDirectory()) {
+        std::cout << "Hard link not allowed for directory: " << source << std::endl;
+        return;
+    }
+
+    std::string directoryPath = currentDirectory;
+    std::string linkName = destination;
+    std::size_t found = destination.find_last_of("/");
+    if (found != std::string::npos) {
+        directoryPath = destination.substr(0, found);
+        linkName = destination.substr(found + 1);
+    }
+    Node* parentNode = findNode(directoryPath);
+    if (parentNode == nullptr || !parentNode->data->getIsDirectory()) {
+        std::cout << "Destination directory does not exist." << std::endl;
+        return;
+    }
+    Node* destinationNode = linkName.empty() ? parentNode : parentNode->findChild(linkName);
+    if (destinationNode != nullptr && destinationNode->data->getIsDirectory()) {
+        if (destinationNode != parentNode) {
+            directoryPath += "/" + linkName;
+        }
+        parentNode = destinationNode;
+        linkName = sourceNode->getName();
+        destinationNode = parentNode->findChild(linkName);
+    }
+    if (destinationNode != nullptr) {
+        std::cout << "Destination item already exists: " << destination << std::endl;
+        return;
+    }
+    if (!Node::isValidName(linkName)) {
+        std::cout << "Invalid link name: " << linkName << std::endl;
+        return;
+    }
+
+    // A hard link is just another directory entry for the same inode.
+    parentNode = writableNode(directoryPath);
+    Node* targetNode = writableNode(sourcePath);
+    writableData(targetNode);
+    Node* linkNode = tree.link(parentNode, linkName, targetNode);
+    pathCache.invalidate(getFullPath(linkNode));
+}
+
+// Prints the selected counts per file, then a total when given several files.
+void FileSystem::wc(const std::vector<std::string>& fileNames, bool showLines, bool showWords, bool showBytes) {
+    auto print = [&](const TextCounts& counts, const std::string& name) {
+        if (showLines) {
+            std::cout << std::setw(8) << std::right << counts.lines;
+        }
+        if (showWords) {
+            std::cout << std::setw(8) << std::right << counts.words;
+        }
+        if (showBytes) {
+            std::cout << std::setw(8) << std::right << counts.bytes;
+        }
+        std::cout << " " << name << std::endl;
+    };
+    TextCounts total;
+    for (const std::string& fileName : fileNames) {
+        Node* fileNode = findNode(fileName);
+        if (!fileNode) {
+            std::cout << "File not found: " << fileName << std::endl;
+            continue;
+        }
+        if (fileNode->data->getIsDirectory()) {
+            std::cout << fileName << ": Is a directory" << std::endl;
+            continue;
+        }
+        const ContentBuffer& content = fileNode->data->getContent();
+        TextCounter counter;
+        for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+            std::string_view chunk = content.chunk(i);
+            counter.update(chunk.data(), chunk.size());
+        }
+        print(counter.getCounts(), fileName);
+        total += counter.getCounts();
+    }
+    if (fileNames.size() > 1) {
+        print(total, "total");
+    }
+}
+
+// Lists the files to search, reading every extent here so that compressed
+// contents are restored before the search threads see them.
+void FileSystem::grep(const std::string& pattern, const std::vector<std::string>& paths, bool recursive, 
+                      Grep::Options options) {
+    std::vector<Grep::Target> targets;
+    std::vector<std::pair<std::string, const Node*>> pending;
+    for (const std::string& path : paths) {
+        const Node* node = findNode(path);
+        if (node == nullptr) {
+            std::cout << "grep: " << path << ": No such file or directory" << std::endl;
+            continue;
+        }
+        if (node->data->getIsDirectory() && !recursive) {
+            std::cout << "grep: " << path << ": Is a directory" << std::endl;
+            continue;
+        }
+        options.showNames = options.showNames || paths.size() > 1 || node->data->getIsDirectory();
+        pending.push_back({path, node});
+        while (!pending.empty()) {
+            std::string name = pending.back().first;
+            const Node* current = pending.back().second;
+            pending.pop_back();
+            if (current->data->getIsDirectory()) {
+                std::string prefix = name.empty() || name.back() != '/' ? name + "/" : name;
+                for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                    pending.push_back({prefix + (*it)->getName(), *it});
+                }
+                continue;
+            }
+            const ContentBuffer& content = current->data->getContent();
+            targets.push_back({name, {}});
+            for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+                targets.back().pieces.push_back(content.chunk(i));
+            }
+        }
+    }
+    std::string error;
+    if (!Grep::run(pattern, targets, options, Grep::defaultThreads(), std::cout, error)) {
+        std::cout << "grep: " << error << std::endl;
+    }
+}
+
+// Sorts the lines of the files together into outputFile, or prints them
+// when it is empty. Reading every extent here restores compressed contents
+// before the sort threads see them, and the result is only stored once the
+// sort is done, so the output may be one of the inputs.
+void FileSystem::sort(const std::vector<std::string>& fileNames, const TextSort::Options& options,
+                      const std::string& outputFile) {
+    std::vector<std::vector<std::string_view>> inputs;
+    for (const std::string& fileName : fileNames) {
+        const Node* node = findNode(fileName);
+        if (node == nullptr || node->data->getIsDirectory()) {
+            std::cout << "sort: " << fileName << (node == nullptr ? ": No such file or directory" : ": Is a directory")
+                      << std::endl;
+            return;
+        }
+        const ContentBuffer& content = node->data->getContent();
+        inputs.emplace_back();
+        for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+            inputs.back().push_back(content.chunk(i));
+        }
+    }
+    std::string error;
+    if (outputFile.empty()) {
+        if (!TextSort::run(inputs, options, TextSort::defaultThreads(), std::cout, error)) {
+            std::cout << "sort: " << error << std::endl;
+        }
+        return;
+    }
+    ContentBuffer sorted;
+    {
+        ContentWriter writer(sorted);
+        std::ostream out(&writer);
+        if (!TextSort::run(inputs, options, TextSort::defaultThreads(), out, error)) {
+            std::cout << "sort: " << error << std::endl;
+            return;
+        }
+    }
+    Node* fileNode = outputNode(outputFile);
+    if (fileNode == nullptr) {
+        return;
+    }
+    File* inode = writableData(fileNode);
+    std::uint64_t oldHash = inode->getHash();
+    inode->setContent(std::move(sorted));
+    tree.updateData(fileNode, oldHash);
+}
+
+// Collapses runs of equal adjacent lines into one, with -c prefixing each
+// with its length and -d printing only the runs of more than one.
+void FileSystem::uniq(const std::string& fileName, bool count, bool duplicatesOnly) {
+    const Node* node = findNode(fileName);
+    if (node == nullptr || node->data->getIsDirectory()) {
+        std::cout << "uniq: " << fileName << (node == nullptr ? ": No such file or directory" : ": Is a directory")
+                  << std::endl;
+        return;
+    }
+    const ContentBuffer& content = node->data->getContent();
+    std::vector<std::string_view> pieces;
+    for (std::size_t i = 0; i < content.chunkCount(); ++i) {
+        pieces.push_back(content.chunk(i));
+    }
+    LineReader reader(pieces);
+    std::string_view line;
+    std::string group;
+    std::uint64_t repeats = 0;
+    auto flush = [&]() {
+        if (repeats == 0 || (duplicatesOnly && repeats == 1)) {
+            return;
+        }
+        if (count) {
+            std::cout << std::setw(7) << std::right << repeats << ' ';
+        }
+        std::cout << group << '\n';
+    };
+    while (reader.next(line)) {
+        if (repeats != 0 && line == group) {
+            ++repeats;
+            continue;
+        }
+        flush();
+        group.assign(line);
+        repeats = 1;
+    }
+    flush();
+    std::cout.flush();
+}
+
+// newerThan names the file for -newer, or is empty.
+void FileSystem::find(const std::vector<std::string>& paths, TreeFind::Criteria criteria, const std::string& newerThan) {
+    if (!newerThan.empty()) {
+        Node* reference = findNode(newerThan);
+        if (reference == nullptr) {
+            std::cout << "find: '" << newerThan << "': No such file or directory" << std::endl;
+            return;
+        }
+        criteria.hasNewer = true;
+        criteria.newer = reference->data->getModifiedTime();
+    }
+    for (const std::string& path : paths) {
+        const Node* node = findNode(path);
+        if (node == nullptr) {
+            std::cout << "find: '" << path << "': No such file or directory" << std::endl;
+            continue;
+        }
+        TreeFind::run(node, path, criteria, TreeFind::defaultThreads(), std::cout);
+    }
+}
+
+// Prints each directory under paths down to maxDepth (all when negative),
+// deepest first, from the totals kept in the nodes; a file argument is
+// printed on its own. Only the directories printed and their entry lists
+// are visited.
+void FileSystem::du(const std::vector<std::string>& paths, int maxDepth, bool human) {
+    struct Visit {
+        const Node* node;
+        std::string path;
+        int depth;
+        bool expanded;
+    };
+    for (const std::string& path : paths) {
+        const Node* start = findNode(path);
+        if (start == nullptr) {
+            std::cout << "du: cannot access '" << path << "': No such file or directory" << std::endl;
+            continue;
+        }
+        std::vector<Visit> pending{{start, path, 0, false}};
+        while (!pending.empty()) {
+            Visit& visit = pending.back();
+            if (!visit.expanded && (maxDepth < 0 || visit.depth < maxDepth)) {
+                visit.expanded = true;
+                Visit parent = visit;
+                std::string prefix = parent.path.back() == '/' ? parent.path : parent.path + "/";
+                for (auto it = parent.node->children.rbegin(); it != parent.node->children.rend(); ++it) {
+                    if ((*it)->data->getIsDirectory()) {
+                        pending.push_back({*it, prefix + (*it)->getName(), parent.depth + 1, false});
+                    }
+                }
+                continue;
+            }
+            std::uint64_t bytes = visit.node->bytes;
+            std::cout << (human ? humanSize(bytes) : std::to_string((bytes + 1023) / 1024)) << "\t" << visit.path << std::endl;
+            pending.pop_back();
+        }
+    }
+}
+
+// Usage of the emulated disk: the bytes of the unique contents held for
+// the tree and its snapshots, and the inodes in use, against the capacity
+// (one inode per 16 KiB of it, the ext4 default).
+void FileSystem::df(bool human, bool inodes) {
+    std::uint64_t used = tree.getBlobs().getStoredBytes();
+    std::uint64_t inodeCapacity = capacity / 16384;
+    std::uint64_t inodesUsed = tree.getInodeCount();
+    auto percent = [](std::uint64_t part, std::uint64_t whole) {
+        return whole == 0 ? std::string("-") : std::to_string((part * 100 + whole - 1) / whole) + "%";
+    };
+    std::ostringstream line;
+    if (inodes) {
+        std::cout << "Filesystem       Inodes    IUsed    IFree IUse% Mounted on" << std::endl;
+        line << std::left << std::setw(12) << "emulatorfs" << std::right << std::setw(11) << inodeCapacity << std::setw(9) 
+             << inodesUsed << std::setw(9) << (inodeCapacity > inodesUsed ? inodeCapacity - inodesUsed : 0) << std::setw(6) 
+             << percent(inodesUsed, inodeCapacity);
+    } else if (human) {
+        std::cout << "Filesystem      Size  Used Avail Use% Mounted on" << std::endl;
+        line << std::left << std::setw(12) << "emulatorfs" << std::right << std::setw(8) << humanSize(capacity) << std::setw(6) 
+             << humanSize(used) << std::setw(6) << humanSize(capacity > used ? capacity - used : 0) << std::setw(5) 
+             << percent(used, capacity);
+    } else {
+        std::cout << "Filesystem     1K-blocks      Used Available Use% Mounted on" << std::endl;
+        line << std::left << std::setw(12) << "emulatorfs" << std::right << std::setw(12) << capacity / 1024 << std::setw(10) 
+             << (used + 1023) / 1024 << std::setw(10) << (capacity > used ? capacity - used : 0) / 1024 << std::setw(5) 
+             << percent(used, capacity);
+    }
+    std::cout << line.str() << " /" << std::endl;
+}
+
+void FileSystem::setCapacity(std::uint64_t bytes) {
+    capacity = bytes;
+}
+
+void FileSystem::fsstat() {
+    unsigned long long hits = pathCache.getHits() + pathCache.getNegativeHits();
+    unsigned long long lookups = hits + pathCache.getMisses();
+    std::cout << "Path cache: " << pathCache.size() << "/" << pathCache.getCapacity() << " entries" << std::endl;
+    std::cout << "Hits: " << pathCache.getHits() << " (negative: " << pathCache.getNegativeHits() << ")" << std::endl;
+    std::cout << "Misses: " << pathCache.getMisses() << std::endl;
+    if (lookups != 0) {
+        std::cout << "Hit ratio: " << std::fixed << std::setprecision(1) << 100.0 * hits / lookups << "%" 
+                  << std::defaultfloat << std::endl;
+    }
+    const SlabAllocator& allocator = tree.getAllocator();
+    const StringPool& names = tree.getNames();
+    std::size_t entries = tree.getNodeCount();
+    std::cout << "Entries: " << entries << ", inodes: " << tree.getInodeCount() << std::endl;
+    std::cout << "sizeof(Node): " << sizeof(Node) << " bytes, sizeof(File): " << sizeof(File) << " bytes" << std::endl;
+    std::cout << "Name pool: " << names.size() << " unique names, " << names.getBytes() << " bytes" << std::endl;
+    if (entries != 0) {
+        std::size_t metadataBytes = entries * sizeof(Node) + tree.getInodeCount() * sizeof(File) + names.getBytes();
+        std::cout << "Bytes per entry: " << metadataBytes / entries << std::endl;
+    }
+    std::cout << "Slab allocator: " << allocator.getSlabCount() << " slabs (" << allocator.getReservedBytes() / 1024 
+              << " KiB), " << allocator.getLiveBlocks() << " live blocks" << std::endl;
+    std::cout << "Allocations: " << allocator.getAllocations() << " served by " << allocator.getSystemAllocations() 
+              << " system allocations" << std::endl;
+    std::cout << "Copy-on-write: " << tree.getCopiedNodes() << " nodes copied" << std::endl;
+    const BlobStore& blobs = tree.getBlobs();
+    std::cout << "Content blobs: " << blobs.size() << " unique, " << blobs.getStoredBytes() << " bytes stored for " 
+              << blobs.getReferencedBytes() << " bytes referenced";
+    if (blobs.getStoredBytes() != 0) {
+        std::cout << " (dedupe ratio " << std::fixed << std::setprecision(2) 
+                  << static_cast<double>(blobs.getReferencedBytes()) / blobs.getStoredBytes() << std::defaultfloat << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "Compression: " << (compressionIdleTime < 0 ? std::string("off") : 
+                                     "after " + std::to_string(compressionIdleTime) + "s idle") 
+              << ", " << blobs.getCompressedCount() << " blobs compressed, " << blobs.getCompressionSavings() 
+              << " bytes saved" << std::endl;
+    std::cout << "Compressions: " << blobs.getCompressions() << ", decompressed on access: " 
+              << blobs.getDecompressions() << std::endl;
+    reclaimStatus();
+}
+
+// Contents not read for idleSeconds get compressed; a negative value turns
+// compression off. Setting it runs a sweep right away.
+void FileSystem::setCompressionIdleTime(long idleSeconds) {
+    compressionIdleTime = idleSeconds;
+    if (idleSeconds < 0) {
+        std::cout << "Compression disabled." << std::endl;
+        return;
+    }
+    std::size_t packed = tree.getBlobs().compressIdle(std::time(nullptr), idleSeconds);
+    nextCompressionSweep = std::time(nullptr) + (idleSeconds > 1 ? idleSeconds / 2 : 1);
+    std::cout << "Compressed " << packed << " files; " << tree.getBlobs().getCompressionSavings() 
+              << " bytes saved in total." << std::endl;
+}
+
+// Called after every command. A sweep visits every blob, so sweeps are
+// spaced half an idle period apart.
+void FileSystem::compressIdleContents() {
+    std::time_t now = std::time(nullptr);
+    if (compressionIdleTime < 0 || now < nextCompressionSweep) {
+        return;
+    }
+    tree.getBlobs().compressIdle(now, compressionIdleTime);
+    nextCompressionSweep = now + (compressionIdleTime > 1 ? compressionIdleTime / 2 : 1);
+}
+
+std::vector<std::string> FileSystem::diff(const FileSystem& other) const {
+    return tree.diff(other.tree);
+}
+
+bool FileSystem::saveImage(const std::string& hostPath, std::size_t& entries, std::string& error) {
+    finishReclaiming();
+    return TreeImage::save(tree, hostPath, entries, error);
+}
+
+// The loaded tree replaces the current one; the shell starts over at "/".
+bool FileSystem::loadImage(const std::string& hostPath, std::size_t& entries, std::string& error) {
+    finishReclaiming();
+    if (!TreeImage::load(hostPath, tree, entries, error)) {
+        return false;
+    }
+    currentDirectory = "/";
+    previousDirectory = "/";
+    pathCache.clear();
+    return true;
+}
+
+bool FileSystem::exportTree(const std::string& path, const std::string& hostDirectory, unsigned threads, 
+                            TreeExport::Stats& stats, std::string& error) const {
+    Node* node = findNode(path);
+    if (node == nullptr) {
+        error = path + ": No such file or directory";
+        return false;
+    }
+    return TreeExport::run(node, hostDirectory, threads, stats, error);
+}
+
+FileSystem::Snapshot FileSystem::takeSnapshot() {
+    finishReclaiming();
+    return Snapshot{tree, currentDirectory, previousDirectory};
+}
+
+void FileSystem::restoreSnapshot(const Snapshot& snapshot) {
+    finishReclaiming();
+    tree = snapshot.tree;
+    currentDirectory = snapshot.currentDirectory;
+    previousDirectory = snapshot.previousDirectory;
+    pathCache.clear();
+}
+
+void FileSystem::clear() {
+    std::cout << "\033[2J\033[1;1H";
+}
+
+// Regular file named by fileName, looked up as given and then relative to
+// the current directory. Prints the usual error and returns nullptr
+// otherwise.
+Node* FileSystem::findFileNode(const std::string& fileName) {
+    Node* fileNode = findNode(fileName);
+    if (fileNode == nullptr) {
+        fileNode = findNode(getCurrentDirectory() + "/" + fileName);
+    }
+    if (fileNode == nullptr || fileNode->data->getIsDirectory()) {
+        std::cout << "File not found or the provided path is a directory." << std::endl;
+        return nullptr;
+    }
+    return fileNode;
+}
+
+// Scans forward and stops after numLines lines; nothing past them is read.
+void FileSystem::head(int numLines, const std::string& fileName) {
+    Node* fileNode = findFileNode(fileName);
+    if (fileNode == nullptr) {
+        return;
+    }
+    const ContentBuffer& content = fileNode->data->getContent();
+    std::size_t start = 0;
+    for (int i = 0; i < numLines && start < content.size(); ++i) {
+        std::size_t end = content.find('\n', start);
+        if (end == ContentBuffer::npos) {
+            end = content.size();
+        }
+        content.write(std::cout, start, end);
+        std::cout << std::endl;
+        start = end + 1;
+    }
+}
+
+// Seeks through the file's newline index straight to the last numLines lines.
+void FileSystem::tail(int numLines, const std::string& fileName) {
+    Node* fileNode = findFileNode(fileName);
+    if (fileNode == nullptr || numLines <= 0) {
+        return;
+    }
+    const ContentBuffer& content = fileNode->data->getContent();
+    std::size_t lines = content.lineCount();
+    std::size_t first = lines > static_cast<std::size_t>(numLines) ? lines - numLines : 0;
+    for (std::size_t line = first; line < lines; ++line) {
+        content.write(std::cout, content.lineStart(line), content.lineEnd(line));
+        std::cout << std::endl;
+    }
+}
+
+void FileSystem::headBytes(std::size_t numBytes, const std::string& fileName) {
+    Node* fileNode = findFileNode(fileName);
+    if (fileNode != nullptr) {
+        fileNode->data->getContent().write(std::cout, 0, numBytes);
+    }
+}
+
+void FileSystem::tailBytes(std::size_t numBytes, const std::string& fileName) {
+    Node* fileNode = findFileNode(fileName);
+    if (fileNode != nullptr) {
+        const ContentBuffer& content = fileNode->data->getContent();
+        content.write(std::cout, content.size() > numBytes ? content.size() - numBytes : 0, content.size());
+    }
+}
+
+void FileSystem::chmod(const std::string& permissions, const std::string& filePath) {
+    Node* fileNode = findNode(filePath);
+    if (fileNode == nullptr) {
+        std::cout << "File not found: " << filePath << std::endl;
+        return;
+    }
+    int octalPermissions = std::stoi(permissions, 0, 8);
+    fileNode = writableNode(filePath);
+    File* inode = writableData(fileNode);
+    std::uint64_t oldHash = inode->getHash();
+    inode->setPermissionsFromOctal(octalPermissions);
+    tree.updateData(fileNode, oldHash);
+}
+
+std::string FileSystem::getCurrentDirectory() const {
+    return currentDirectory;
+}
+
+void FileSystem::setCurrentDirectory(const std::string& c) {
+    currentDirectory = c;
+}
+
+std::string normalizePath(const std::string& path) {
+    if (path.empty() || path == "/") {
+        return "/";
+    }
+
+    std::string normalized;
+    normalized.reserve(path.size() + 1);
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        std::size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        std::size_t length = end - start;
+        if (length == 2 && path[start] == '.' && path[start + 1] == '.') {
+            std::size_t lastSlash = normalized.find_last_of('/');
+            normalized.erase(lastSlash == std::string::npos ? 0 : lastSlash);
+        } else if (length != 0 && !(length == 1 && path[start] == '.')) {
+            normalized += '/';
+            normalized.append(path, start, length);
+        }
+        start = end + 1;
+    }
+
+    if (normalized.empty()) {
+        normalized = "/";
+    }
+
+    return normalized;
+}
+
+// True when path names ancestor or something below it (both normalized).
+bool isWithin(const std::string& path, const std::string& ancestor) {
+    if (ancestor == "/") {
+        return true;
+    }
+    return path.compare(0, ancestor.size(), ancestor) == 0 
+           && (path.size() == ancestor.size() || path[ancestor.size()] == '/');
+}
+
+Node* findChildNode(Node* parent, const std::string& name) {
+    return parent->findChild(name);
+}
+
+Node* FileSystem::findNode(const std::string& path) const {
+    std::string normalizedPath = normalizePath(path);
+    Node* currentNode = nullptr;
+    if (pathCache.lookup(normalizedPath, currentNode)) {
+        return currentNode;
+    }
+
+    currentNode = tree.getRoot();
+    std::string part;
+    std::size_t start = 1;
+    while (currentNode != nullptr && start < normalizedPath.size()) {
+        std::size_t end = normalizedPath.find('/', start);
+        if (end == std::string::npos) {
+            end = normalizedPath.size();
+        }
+        part.assign(normalizedPath, start, end - start);
+        Node* child = findChildNode(currentNode, part);
+        if (child != nullptr) {
+            child->parent = currentNode; // nodes shared with snapshots may point elsewhere
+        }
+        currentNode = child;
+        start = end + 1;
+    }
+    pathCache.insert(normalizedPath, currentNode); // nullptr is remembered as a miss
+    return currentNode;
+}
+
+// Path-copies the nodes from the root down to path that are shared with a
+// snapshot. Cached lookups may point at the shared originals, so the cache
+// is dropped whenever something was copied.
+Node* FileSystem::writableNode(const std::string& path) {
+    unsigned long long copiedNodes = tree.getCopiedNodes();
+    Node* node = tree.makeWritable(normalizePath(path));
+    if (tree.getCopiedNodes() != copiedNodes) {
+        pathCache.clear();
+    }
+    return node;
+}
+
+File* FileSystem::writableData(Node* node) {
+    unsigned long long copiedNodes = tree.getCopiedNodes();
+    File* inode = tree.makeDataWritable(node);
+    if (tree.getCopiedNodes() != copiedNodes) {
+        pathCache.clear();
+    }
+    return inode;
+}
+
+std::string FileSystem::getFullPath(Node* node) {
+    return node->getAbsolutePath();
+}
+
+void FileSystem::pwd() {
+    std::cout << normalizePath(currentDirectory) << std::endl;
+}
+
+void FileSystem::help() {
+    CommandValidator cv;
+    for (const auto& option : cv.getValidOptions()) {
+        std::cout << option.first << ": ";
+        for (const auto& value : option.second) {
+            std::cout << value << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void FileSystem::cd(const std::string& directoryPath) {
+    std::string newPath = directoryPath;
+    std::string homeDirectory = "/home/username";
+    if (newPath == "~") {
+        newPath = homeDirectory;
+    } else if (newPath == "-") {
+        std::swap(currentDirectory, previousDirectory); // Swap current and previous directories
+        std::cout << "Current directory changed to: " << currentDirectory << std::endl;
+        return;
+    } else if (newPath == "..") {
+        size_t lastSlashIndex = currentDirectory.find_last_of('/');
+        if (lastSlashIndex != std::string::npos) {
+            newPath = currentDirectory.substr(0, lastSlashIndex);
+        } else {
+            std::cout << "Error: Cannot go up from root directory." << std::endl;
+            return;
+        }
+    } else if (newPath == ".") {
+        return;
+    }
+    Node* directoryNode = findNode(newPath);
+    if (directoryNode == nullptr) {
+        std::cout << "No such file or directory." << std::endl;
+        return;
+    }
+    if (!directoryNode->data->getIsDirectory()) {
+        std::cout << "Error: Not a directory." << std::endl;
+        return;
+    }
+    previousDirectory = currentDirectory;
+    currentDirectory = newPath;
+    std::cout << "Current directory changed to: " << currentDirectory << std::endl;
+}
+
+void FileSystem::createFile(const std::string& filePath) {
+    if (filePath.empty()) {
+        std::cout << "Invalid file path. Please provide a valid file path or filename." << std::endl;
+        return;
+    }
+    std::size_t found = filePath.find_last_of("/");
+    std::string directoryPath;
+    std::string fileName;
+    if (found != std::string::npos) {
+        directoryPath = filePath.substr(0, found);
+        fileName = filePath.substr(found + 1);
+    } else {
+        directoryPath = currentDirectory;
+        fileName = filePath;
+    }
+
+    if (!Node::isValidName(fileName)) {
+        std::cout << "Invalid file name: " << fileName << std::endl;
+        return;
+    }
+    Node* parentNode = findNode(directoryPath);
+    if (parentNode == nullptr || !parentNode->data->getIsDirectory()) {
+        std::cout << "Directory does not exist. File creation failed." << std::endl;
+        return;
+    }
+    Node* existingNode = findChildNode(parentNode, fileName);
+    if (existingNode != nullptr) {
+        if (existingNode->data->getIsDirectory()) {
+            std::cout << "Directory with the same name already exists in the directory. File creation failed." << std::endl;
+        } else {
+            std::cout << "File with the same name already exists in the directory. File creation failed." << std::endl;
+        }
+        return;
+    }
+    File file(nullptr, Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
+                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
+                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, false);
+    Node* fileNode = tree.insert(writableNode(directoryPath), fileName, file);
+    pathCache.invalidate(getFullPath(fileNode));
+}
+
+void FileSystem::createDirectory(const std::string& directoryName) {
+    std::string currentPath = currentDirectory;
+    std::size_t slashPos = directoryName.find_last_of('/');
+    std::string name = slashPos == std::string::npos ? directoryName : directoryName.substr(slashPos + 1);
+    if (!Node::isValidName(name)) {
+        std::cout << "Invalid directory name: " << name << std::endl;
+        return;
+    }
+    if (slashPos != std::string::npos) {
+        std::string path = directoryName.substr(0, slashPos);
+        currentPath = directoryName[0] == '/' ? (path.empty() ? "/" : path) : currentPath + "/" + path;
+        Node* parentNode = findNode(currentPath);
+        if (parentNode == nullptr || !parentNode->data->getIsDirectory()) {
+            std::cout << "Parent directory does not exist." << std::endl;
+            return;
+        }
+        if (findChildNode(parentNode, name) != nullptr) {
+            std::cout << "Directory already exists." << std::endl;
+            return;
+        }
+        File newDirectory(nullptr, Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
+                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
+                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, true);
+        Node* newDirectoryNode = tree.insert(writableNode(currentPath), name, newDirectory);
+        pathCache.invalidate(getFullPath(newDirectoryNode));
+        std::cout << "Directory created successfully." << std::endl;
+    } else {
+        Node* parentNode = findNode(currentPath);
+        if (parentNode == nullptr || !parentNode->data->getIsDirectory()) {
+            std::cout << "Parent directory does not exist." << std::endl;
+            return;
+        }
+        if (findChildNode(parentNode, directoryName) != nullptr) {
+            std::cout << "Directory already exists." << std::endl;
+            return;
+        }
+        File newDirectory(nullptr, Permission::OwnerRead | Permission::OwnerWrite | Permission::OwnerExecute | 
+                  Permission::GroupRead | Permission::GroupWrite | Permission::GroupExecute | 
+                  Permission::OthersRead | Permission::OthersWrite | Permission::OthersExecute, true);
+        Node* newDirectoryNode = tree.insert(writableNode(currentPath), directoryName, newDirectory);
+        pathCache.invalidate(getFullPath(newDirectoryNode));
+        std::cout << "Created" << std::endl;
+    }
+}
+
+void FileSystem::readFile(const std::string& fileName) {
+    Node* fileNode = findNode(fileName);
+    if (fileNode == nullptr) {
+        std::string currentDirectory = getCurrentDirectory();
+        std::string filePath = currentDirectory + "/" + fileName;
+        fileNode = findNode(filePath);
+    }
+    if (fileNode == nullptr || fileNode->data->getIsDirectory()) {
+        std::cout << "File not found or the provided path is a directory." << std::endl;
+        return;
+    }
+    const ContentBuffer& content = fileNode->data->getContent();
+    content.write(std::cout, 0, content.size());
+    std::cout << std::endl;
+}
+
+// Returns the text written, which is empty if the file could not be edited.
+std::string FileSystem::writeFile(const std::string& fileName) {
+    std::cout << "If you end typing press !q" << std::endl;
+    std::string filePath = fileName;
+    Node* fileNode = findNode(filePath);
+    if (fileNode == nullptr) {
+        filePath = getCurrentDirectory() + "/" + fileName;
+        fileNode = findNode(filePath);
+    }
+    if (fileNode == nullptr || fileNode->data->getIsDirectory()) {
+        std::cout << "File not found or the provided path is a directory." << std::endl;
+        return "";
+    }
+    std::string input;
+    std::ostringstream contentStream;
+    while (getline(std::cin, input) && input != "!q") {
+        contentStream << input << '\n';
+    }
+    std::string content = contentStream.str();
+    fileNode = writableNode(filePath);
+    File* inode = writableData(fileNode);
+    std::uint64_t oldHash = inode->getHash();
+    inode->setContent(content);
+    tree.updateData(fileNode, oldHash);
+    return content;
+}
+
+// The writable node of the file that output to fileName goes to, created
+// if needed, or null after saying why there is none.
+Node* FileSystem::outputNode(const std::string& fileName) {
+    std::string filePath = fileName;
+    Node* fileNode = findNode(filePath);
+    if (fileNode == nullptr && fileName.find('/') == std::string::npos) {
+        filePath = getCurrentDirectory() + "/" + fileName;
+        fileNode = findNode(filePath);
+    }
+    if (fileNode == nullptr) {
+        createFile(fileName);
+        fileNode = findNode(filePath);
+    }
+    if (fileNode == nullptr || fileNode->data->getIsDirectory()) {
+        std::cout << "File not found or the provided path is a directory." << std::endl;
+        return nullptr;
+    }
+    return writableNode(filePath);
+}
+
+// Target of "echo text > file" and "echo text >> file". The file is created
+// if needed; appending copies and hashes only the new bytes.
+void FileSystem::echoToFile(const std::string& fileName, const std::string& text, bool append) {
+    Node* fileNode = outputNode(fileName);
+    if (fileNode == nullptr) {
+        return;
+    }
+    File* inode = writableData(fileNode);
+    std::uint64_t oldHash = inode->getHash();
+    if (append) {
+        inode->appendContent(text);
+    } else {
+        inode->setContent(text);
+    }
+    tree.updateData(fileNode, oldHash);
+}
+
+// Copies source to destination, or into it when it is a directory. The
+// copy keeps the source's mode and shares its content; directories need
+// recursive and are cloned in one pass (see GeneralTree::clone), and
+// preserve also keeps times, owners and hard links, as cp -a does.
+void FileSystem::copyFile(const std::string& source, const std::string& destination, bool recursive, bool preserve) {
+    Node* sourceNode = findNode(source);
+    std::string sourcePath = normalizePath(source);
+    if (sourceNode == nullptr) {
+        sourcePath = normalizePath(getCurrentDirectory() + "/" + source);
+        sourceNode = findNode(sourcePath);
+    }
+    if (sourceNode == nullptr) {
+        std::cout << "Source path not found." << std::endl;
+        return;
+    }
+    if (sourceNode->data->getIsDirectory() && !recursive) {
+        std::cout << "cp: -r not specified; omitting directory '" << source << "'" << std::endl;
+        return;
+    }
+    std::string destinationDirectory;
+    std::string destinationName;
+    Node* destinationNode = findNode(destination);
+    if (destinationNode != nullptr && destinationNode->data->getIsDirectory()) {
+        destinationDirectory = normalizePath(destination);
+        destinationName = sourceNode->getName();
+    } else if (destinationNode != nullptr) {
+        std::cout << "Destination path already exists." << std::endl;
+        return;
+    } else {
+        // A bare name is created in the current directory.
+        std::size_t found = destination.find_last_of("/");
+        destinationDirectory = found == std::string::npos ? getCurrentDirectory() :
+                               normalizePath(found == 0 ? "/" : destination.substr(0, found));
+        destinationName = found == std::string::npos ? destination : destination.substr(found + 1);
+    }
+    Node* destinationParentNode = findNode(destinationDirectory);
+    if (destinationParentNode == nullptr || !destinationParentNode->data->getIsDirectory() || destinationName.empty()) {
+        std::cout << "Destination directory does not exist." << std::endl;
+        return;
+    }
+    if (!Node::isValidName(destinationName)) {
+        std::cout << "Invalid destination name: " << destinationName << std::endl;
+        return;
+    }
+    if (findChildNode(destinationParentNode, destinationName) != nullptr) {
+        std::cout << "Destination path already exists." << std::endl;
+        return;
+    }
+    if (sourceNode->data->getIsDirectory() && isWithin(destinationDirectory, sourcePath)) {
+        std::cout << "cp: cannot copy a directory, '" << source << "', into itself" << std::endl;
+        return;
+    }
+    // The clone only reads the source, so it is built before the
+    // destination path is made writable.
+    Node* copy = tree.clone(sourceNode, destinationName, preserve);
+    tree.insert(writableNode(destinationDirectory), copy);
+    pathCache.invalidateSubtree(getFullPath(copy));
+    std::cout << (copy->data->getIsDirectory() ? "Directory copied successfully." : "File copied successfully.") << std::endl;
+}
+
+
+void FileSystem::moveFile(const std::string& source, const std::string& destination) {
+    Node* sourceNode = findNode(source);
+    Node* destinationNode = findNode(destination);
+    if (sourceNode == nullptr) {
+        std::cout << "Source path not found." << std::endl;
+        return;
+    }
+    if (destinationNode != nullptr && destinationNode->data->getIsDirectory()) {
+        if (isWithin(normalizePath(destination), normalizePath(source))) {
+            std::cout << "Cannot move a directory into itself." << std::endl;
+            return;
+        }
+        if (findChildNode(destinationNode, sourceNode->getName()) != nullptr) {
+            std::cout << "A file or directory already exists at the destination path." << std::endl;
+            return;
+        }
+        sourceNode = writableNode(source);
+        destinationNode = writableNode(destination);
+        pathCache.invalidateSubtree(getFullPath(sourceNode));
+        tree.move(sourceNode, destinationNode, sourceNode->getName());
+        pathCache.invalidateSubtree(getFullPath(sourceNode));
+        std::cout << "File or directory moved successfully." << std::endl;
+    } else {
+        std::size_t found = destination.find_last_of("/");
+        if (found == std::string::npos) {
+            std::cout << "Invalid destination path. Please provide the full path including the directory." << std::endl;
+            return;
+        }
+        std::string destinationDirectory = destination.substr(0, found);
+        std::string destinationName = destination.substr(found + 1);
+        if (!Node::isValidName(destinationName)) {
+            std::cout << "Invalid destination name: " << destinationName << std::endl;
+            return;
+        }
+        Node* destinationParentNode = findNode(destinationDirectory);
+        if (destinationParentNode == nullptr || !destinationParentNode->data->getIsDirectory()) {
+            std::cout << "Destination directory does not exist." << std::endl;
+            return;
+        }
+        if (isWithin(normalizePath(destinationDirectory), normalizePath(source))) {
+            std::cout << "Cannot move a directory into itself." << std::endl;
+            return;
+        }
+        if (findChildNode(destinationParentNode, destinationName) != nullptr) {
+            std::cout << "A file or directory already exists at the destination path." << std::endl;
+            return;
+        }
+        sourceNode = writableNode(source);
+        destinationParentNode = writableNode(destinationDirectory);
+        pathCache.invalidateSubtree(getFullPath(sourceNode));
+        tree.move(sourceNode, destinationParentNode, destinationName);
+        pathCache.invalidateSubtree(getFullPath(sourceNode));
+        std::cout << "File or directory moved successfully." << std::endl;
+    }
+}
+
+void FileSystem::renameItem(const std::string& itemPath, const std::string& newName) {
+    if (findNode(itemPath) == nullptr) {
+        std::cout << "Item not found." << std::endl;
+        return;
+    }
+    if (!Node::isValidName(newName)) {
+        std::cout << "Invalid name: " << newName << std::endl;
+        return;
+    }
+    Node* itemNode = writableNode(itemPath);
+    Node* parentNode = itemNode->parent;
+    if (parentNode != nullptr && findChildNode(parentNode, newName) != nullptr) {
+        std::cout << "A file or directory with that name already exists." << std::endl;
+        return;
+    }
+    pathCache.invalidateSubtree(getFullPath(itemNode));
+    tree.rename(itemNode, newName);
+    pathCache.invalidateSubtree(getFullPath(itemNode));
+    std::cout << "Item renamed successfully." << std::endl;
+}
+
+// rm: a directory needs recursive, and force keeps quiet about missing
+// paths. The whole subtree goes in one iterative pass, GeneralTree::remove
+// freeing every node once, so neither its size nor its depth matters.
+void FileSystem::deleteFile(const std::string& filePath, bool recursive, bool force) {
+    Node* fileNode = findNode(filePath);
+    if (fileNode == nullptr) {
+        if (!force) {
+            std::cout << "File or directory not found." << std::endl;
+        }
+        return;
+    }
+    std::string path = normalizePath(filePath);
+    if (path == "/") {
+        std::cout << "rm: refusing to remove '/'" << std::endl;
+        return;
+    }
+    if (fileNode->data->getIsDirectory() && !recursive) {
+        std::cout << "rm: cannot remove '" << filePath << "': Is a directory" << std::endl;
+        return;
+    }
+    if (reclaimer != nullptr) {
+        // Only the link to the parent is cut here; the reclaimer thread frees
+        // the subtree and reports the hard links it had (see settleReclaimed).
+        pathCache.invalidateSubtree(path);
+        reclaimer->add(tree.getStorage(), tree.unlink(writableNode(path)));
+        std::cout << "File or directory deleted successfully." << std::endl;
+        return;
+    }
+    // Every entry in the subtree is one link of its inode. Inodes that keep a
+    // name elsewhere need their link count lowered; the rest go with the tree.
+    // The walk only keeps the directories and those links, and each inode is
+    // updated once, through the path of its first name in the subtree.
+    struct Visit {
+        Node* node;
+        std::size_t parent;
+    };
+    std::vector<Visit> visits{{fileNode, 0}};
+    std::unordered_map<const File*, std::pair<std::size_t, int>> linked;
+    for (std::size_t i = 0; i < visits.size(); ++i) {
+        const File* data = visits[i].node->data;
+        if (!data->getIsDirectory() && data->getLinkCount() > 1) {
+            ++linked.emplace(data, std::make_pair(i, 0)).first->second.second;
+        }
+        for (Node* child : visits[i].node->children) {
+            if (!child->children.empty() || (!child->data->getIsDirectory() && child->data->getLinkCount() > 1)) {
+                visits.push_back({child, i});
+            }
+        }
+    }
+    for (const auto& link : linked) {
+        std::string linkPath;
+        for (std::size_t j = link.second.first; j != 0; j = visits[j].parent) {
+            linkPath = "/" + visits[j].node->getName() + linkPath;
+        }
+        File* inode = writableData(writableNode(path + linkPath));
+        inode->setLinkCount(inode->getLinkCount() - link.second.second);
+    }
+    pathCache.invalidateSubtree(path);
+    tree.remove(writableNode(path));
+    std::cout << "File or directory deleted successfully." << std::endl;
+}
+
+// Turns deferred reclaiming on or off. Turning it off frees what is still
+// queued before returning.
+void FileSystem::setDeferredReclaim(bool deferred) {
+    if (deferred && reclaimer == nullptr) {
+        reclaimer = std::make_shared<Reclaimer>();
+    } else if (!deferred && reclaimer != nullptr) {
+        finishReclaiming();
+        reclaimer.reset();
+    }
+}
+
+void FileSystem::reclaimStatus() const {
+    if (reclaimer == nullptr) {
+        std::cout << "Reclaim: immediate" << std::endl;
+        return;
+    }
+    Reclaimer::Stats stats = reclaimer->getStats();
+    std::cout << "Reclaim: deferred, " << stats.pendingEntries << " entries (" << humanSize(stats.pendingBytes) 
+              << ") pending, " << stats.reclaimedEntries << " entries (" << humanSize(stats.reclaimedBytes) 
+              << ") reclaimed in " << stats.batches << " batches" << std::endl;
+}
+
+// Holds off the reclaimer while a command runs, and first lowers the link
+// counts it left to settle.
+StorageLock FileSystem::lockStorage() {
+    StorageLock lock(tree.getStorage());
+    settleReclaimed();
+    return lock;
+}
+
+// The reclaimer lists every name it took from a file that had other links,
+// and keeps its entry until here. The entry is still in its inode's ring,
+// which leads to the names left in the tree; the link count is then set to
+// their number. Only called with the storage locked.
+void FileSystem::settleReclaimed() {
+    if (reclaimer == nullptr) {
+        return;
+    }
+    std::vector<Reclaimer::Unlinked> unlinked = reclaimer->takeUnlinked();
+    if (unlinked.empty()) {
+        return;
+    }
+    std::shared_ptr<TreeStorage> storage = tree.getStorage();
+    std::unordered_map<const File*, std::pair<Node*, int>> lost;
+    for (const Reclaimer::Unlinked& entry : unlinked) {
+        if (entry.storage == storage) {
+            ++lost.emplace(entry.node->data, std::make_pair(entry.node, 0)).first->second.second;
+        }
+    }
+    std::vector<std::vector<Node*>> names;
+    for (const auto& inode : lost) {
+        names.push_back(tree.findLinks(inode.second.first, inode.first->getLinkCount() - inode.second.second));
+    }
+    // The entries are released before the counts are set: until then they
+    // make every inode look shared with another version.
+    for (const Reclaimer::Unlinked& entry : unlinked) {
+        StorageLock lock(entry.storage);
+        GeneralTree::release(*entry.storage, entry.node);
+    }
+    unsigned long long copiedNodes = tree.getCopiedNodes();
+    for (const std::vector<Node*>& inodeNames : names) {
+        tree.settleLinks(inodeNames);
+    }
+    if (tree.getCopiedNodes() != copiedNodes) {
+        pathCache.clear();
+    }
+}
+
+// Frees what is still queued and settles it. Link counts lowered late would
+// land in whatever tree is current by then, so this runs before the tree is
+// kept, saved or replaced as a whole. Only called with the storage locked.
+void FileSystem::finishReclaiming() {
+    if (reclaimer != nullptr) {
+        reclaimer->drain();
+        settleReclaimed();
+    }
+}
+
+void FileSystem::removeDirectory(const std::string& directoryPath) {
+    Node* directoryNode = findNode(directoryPath);
+    std::string problem = directoryNode == nullptr ? "No such file or directory" :
+                          !directoryNode->data->getIsDirectory() ? "Not a directory" :
+                          !directoryNode->children.empty() ? "Directory not empty" :
+                          normalizePath(directoryPath) == "/" ? "Device or resource busy" : "";
+    if (!problem.empty()) {
+        std::cout << "rmdir: failed to remove '" << directoryPath << "': " << problem << std::endl;
+        return;
+    }
+    std::string path = normalizePath(directoryPath);
+    pathCache.invalidateSubtree(path);
+    tree.remove(writableNode(path));
+    std::cout << "Directory deleted successfully." << std::endl;
+}
+
+void printColoredText(const std::string& text, int colorCode) {
+    std::cout << "\033[" << colorCode << "m" << text << "\033[0m";
+}
+
+void FileSystem::ls() {
+    Node* currentNode = findNode(currentDirectory);
+    if (currentNode == nullptr || !currentNode->data->getIsDirectory()) {
+        std::cout << "Current directory not found." << std::endl;
+        return;
+    }
+    std::cout << "Listing directory: " << currentDirectory << std::endl;
+    for (Node* child : currentNode->children) {
+        if (child->data->getIsDirectory()) {
+            printColoredText(child->getName(), 34);
+            std::cout << std::endl;
+        }
+        else {
+            printColoredText(child->getName(), 32);
+            std::cout << std::endl;
+        }
+    }
+}
+
+void FileSystem::lsDetailed() {
+    Node* currentNode = findNode(currentDirectory);
+    if (currentNode == nullptr || !currentNode->data->getIsDirectory()) {
+        std::cout << "Current directory not found." << std::endl;
+        return;
+    }
+    std::cout << "Detailed listing of directory: " << currentDirectory << std::endl;
+    for (Node* child : currentNode->children) {
+        if (child->data->getIsDirectory()) {
+            printColoredText(child->getName(), 34);
+        }
+        else {
+            printColoredText(child->getName(), 32);
+        }
+        std::cout << " " << child->data->getPermissionsString();
+        std::cout << std::endl;
+    }
+}
+
+void FileSystem::lsSortedByTime() {
+    Node* currentNode = findNode(currentDirectory);
+    if (currentNode == nullptr || !currentNode->data->getIsDirectory()) {
+        std::cout << "Current directory not found." << std::endl;
+        return;
+    }
+    std::cout << "Listing directory sorted by time: " << currentDirectory << std::endl;
+    std::vector<Node*> sortedChildren = currentNode->children;
+    std::stable_sort(sortedChildren.begin(), sortedChildren.end(), [](Node* a, Node* b) {
+        return a->data->getModifiedTime() > b->data->getModifiedTime();
+    });
+    for (Node* child : sortedChildren) {
+        std::time_t modifiedTime = child->data->getModifiedTime();
+        if (child->data->getIsDirectory()) {
+            printColoredText(child->getName(), 34);
+            std::cout << " " << std::put_time(std::localtime(&modifiedTime), "%Y-%m-%d %H:%M:%S") << std::endl;
+        } else {
+            printColoredText(child->getName(), 32);
+            std::cout << " " << std::put_time(std::localtime(&modifiedTime), "%Y-%m-%d %H:%M:%S") << std::endl;
+        }
+    }
+}
+
+void FileSystem::lsLongFormat() {
+    Node* currentNode = findNode(currentDirectory);
+    if (currentNode == nullptr || !currentNode->data->getIsDirectory()) {
+        std::cout << "Current directory not found." << std::endl;
+        return;
+    }
+    std::cout << "Long format listing of directory: " << currentDirectory << std::endl;
+    for (Node* child : currentNode->children) {
+        std::cout << (child->data->getIsDirectory() ? "d" : "-");
+        std::cout << child->data->getPermissionsString() << " ";
+        std::cout << child->data->getLinkCount() << " ";
+        std::cout << child->data->getOwnerId() << " " << child->data->getGroupId() << " ";
+        std::cout << std::setw(8) << std::right << child->data->getSize() << " ";
+        std::time_t modifiedTime = child->data->getModifiedTime();
+        std::cout << std::put_time(std::localtime(&modifiedTime), "%b %d %H:%M") << " ";
+        if (child->data->getIsDirectory()) {
+            printColoredText(child->getName(), 34);
+            std::cout << std::endl;
+        }
+        else {
+            printColoredText(child->getName(), 32);
+            std::cout << std::endl;
+        }
+    }
+}
+
+} // namespace LinuxEmulator
+
 #endif  // LINUX_EMULATOR_FILESYSTEM_H
\ No newline at end of file
@@ -0,0 +1,228 @@
+#ifndef LINUX_EMULATOR_FIND_H
+#define LINUX_EMULATOR_FIND_H
+
+#include "gtree.h"
+#include "boundedqueue.h"
+
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// find over a subtree on a work-stealing pool. A task is one directory:
+// the worker that runs it tests every entry, reports the matches and queues
+// the subdirectories on its own deque. Workers take their newest task first,
+// which keeps the walk depth-first and the deques short, and when their
+// deque runs dry they steal the oldest task of another worker, which is the
+// largest subtree it knows of. There is no recursion, so the depth of the
+// tree is not limited by any stack. Matches go to the printing thread in
+// batches through a BoundedQueue, a batch being handed over when it is full
+// or flushMilliseconds old, so the first ones are printed while the
+// walk goes on and a slow terminal holds the workers back instead of
+// letting the results pile up. The order of the results depends on the
+// scheduling, as with any parallel walk.
+//
+// Workers only read nodes and inode metadata, never file contents, so the
+// tree must simply not change while the walk runs.
+class TreeFind {
+public:
+    enum class PermissionMatch { Exact, AllOf, AnyOf };
+    struct Criteria {
+        bool hasName;
+        std::string name;
+        char type;
+        int permissions;
+        PermissionMatch permissionMatch;
+        int maxDepth;
+        bool hasNewer;
+        std::time_t newer;
+        Criteria();
+    };
+    static unsigned defaultThreads();
+    static std::uint64_t run(const Node*, const std::string&, const Criteria&, unsigned, std::ostream&);
+private:
+    static const std::size_t batchSize = 256;
+    static const std::size_t queueBatches = 64;
+    static constexpr int flushMilliseconds = 10;
+    struct Task {
+        const Node* node;
+        std::string path;
+        int depth;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    TreeFind(const Criteria&, unsigned);
+    bool matches(const Node*) const;
+    bool take(unsigned, Task&);
+    void work(unsigned);
+    void report(std::vector<std::string>&, std::string&&);
+    const Criteria& criteria;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> outstanding;
+    std::atomic<unsigned> running;
+    BoundedQueue<std::vector<std::string>> results;
+};
+
+TreeFind::Criteria::Criteria()
+    : hasName{false}, type{0}, permissions{-1}, permissionMatch{PermissionMatch::Exact}, maxDepth{-1},
+      hasNewer{false}, newer{0} {}
+
+TreeFind::TreeFind(const Criteria& c, unsigned threads) : criteria{c}, outstanding{0}, running{threads},
+    results{queueBatches} {
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(new Worker());
+    }
+}
+
+unsigned TreeFind::defaultThreads() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::min(std::max(cores, 1U), 8U);
+}
+
+bool TreeFind::matches(const Node* node) const {
+    const File* data = node->data;
+    if (criteria.type != 0 && data->getIsDirectory() != (criteria.type == 'd')) {
+        return false;
+    }
+    if (criteria.permissions >= 0) {
+        int mode = data->getOctalPermissions();
+        bool ok = criteria.permissionMatch == PermissionMatch::Exact ? mode == criteria.permissions :
+                  criteria.permissionMatch == PermissionMatch::AllOf ? (mode & criteria.permissions) == criteria.permissions :
+                  criteria.permissions == 0 || (mode & criteria.permissions) != 0;
+        if (!ok) {
+            return false;
+        }
+    }
+    if (criteria.hasNewer && data->getModifiedTime() <= criteria.newer) {
+        return false;
+    }
+    return !criteria.hasName || fnmatch(criteria.name.c_str(), node->getName().c_str(), 0) == 0;
+}
+
+// Pops the newest task of worker self, or steals the oldest one of another.
+bool TreeFind::take(unsigned self, Task& task) {
+    {
+        std::lock_guard<std::mutex> lock(workers[self]->mutex);
+        if (!workers[self]->tasks.empty()) {
+            task = std::move(workers[self]->tasks.back());
+            workers[self]->tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < workers.size(); ++i) {
+        Worker& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TreeFind::report(std::vector<std::string>& batch, std::string&& path) {
+    batch.push_back(std::move(path));
+    if (batch.size() >= batchSize) {
+        results.push(std::move(batch));
+        batch.clear();
+    }
+}
+
+void TreeFind::work(unsigned self) {
+    Worker& worker = *workers[self];
+    std::vector<std::string> batch;
+    unsigned idle = 0;
+    Task task;
+    auto flushed = std::chrono::steady_clock::now();
+    // outstanding counts queued and running tasks, so it reaches zero only
+    // when no task is left anywhere and none can be created.
+    while (outstanding.load() != 0) {
+        if (!take(self, task)) {
+            if (++idle < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            continue;
+        }
+        idle = 0;
+        std::string prefix = task.path.empty() || task.path.back() != '/' ? task.path + "/" : task.path;
+        bool descend = criteria.maxDepth < 0 || task.depth + 1 < criteria.maxDepth;
+        for (const Node* child : task.node->children) {
+            std::string path = prefix + child->getName();
+            if (descend && child->data->getIsDirectory()) {
+                ++outstanding;
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.tasks.push_back({child, path, task.depth + 1});
+            }
+            if (matches(child)) {
+                report(batch, std::move(path));
+            }
+        }
+        --outstanding;
+        if (!batch.empty() && std::chrono::steady_clock::now() - flushed > std::chrono::milliseconds(flushMilliseconds)) {
+            results.push(std::move(batch));
+            batch.clear();
+            flushed = std::chrono::steady_clock::now();
+        }
+    }
+    if (!batch.empty()) {
+        results.push(std::move(batch));
+    }
+    if (--running == 0) {
+        results.close();
+    }
+}
+
+// Prints the paths under root, named from rootPath, that meet criteria, and
+// returns how many there were.
+std::uint64_t TreeFind::run(const Node* root, const std::string& rootPath, const Criteria& criteria, unsigned threads,
+                            std::ostream& out) {
+    threads = std::max(threads, 1U);
+    TreeFind find(criteria, threads);
+    std::uint64_t matched = 0;
+    if (find.matches(root)) {
+        out << rootPath << '\n';
+        ++matched;
+    }
+    if (root->data->getIsDirectory() && criteria.maxDepth != 0) {
+        find.outstanding = 1;
+        find.workers[0]->tasks.push_back({root, rootPath, 0});
+    }
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; ++i) {
+        pool.emplace_back(&TreeFind::work, &find, i);
+    }
+    std::vector<std::string> batch;
+    while (find.results.pop(batch)) {
+        for (const std::string& path : batch) {
+            out << path << '\n';
+        }
+        matched += batch.size();
+    }
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+    out.flush();
+    return matched;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_FIND_H
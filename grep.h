@@ -0,0 +1,336 @@
+#ifndef LINUX_EMULATOR_GREP_H
+#define LINUX_EMULATOR_GREP_H
+
+#include "regex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace LinuxEmulator {
+
+// Finds a fixed string. Candidates are found a block at a time by comparing
+// the needle's first and last bytes against the text at the matching
+// distance (both cases of each under ignoreCase), with AVX2 or SSE2 chosen at
+// compile time as in TextCounter, so only positions where both agree are
+// compared in full. Pairing the two bytes keeps common first letters from
+// flooding the full comparison.
+class LiteralSearcher {
+public:
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+    LiteralSearcher(const std::string&, bool);
+    std::size_t find(const char*, std::size_t, std::size_t) const;
+private:
+    static char lower(char);
+    bool matchesAt(const char*) const;
+    std::string needle;
+    bool ignoreCase;
+};
+
+// grep over a list of files. The caller hands over each file's content as
+// the views of its extents, so the workers read plain bytes and never touch
+// the tree. Every file is searched as one contiguous text: a file whose
+// extents are not adjacent is first copied into a per-thread buffer. Files
+// are claimed one at a time by a pool of threads, each with its own DFA,
+// and their output is printed strictly in the order of the list, as soon as
+// every file before it is done.
+class Grep {
+public:
+    struct Options {
+        bool ignoreCase;
+        bool lineNumbers;
+        bool countOnly;
+        bool filesOnly;
+        bool extended;
+        bool fixed;
+        bool showNames;
+        Options();
+    };
+    struct Target {
+        std::string name;
+        std::vector<std::string_view> pieces;
+    };
+    static unsigned defaultThreads();
+    static bool run(const std::string&, const std::vector<Target>&, const Options&, unsigned, std::ostream&,
+                    std::string&);
+private:
+    static bool isLiteral(const std::string&, bool);
+    static std::string unescape(const std::string&);
+    Grep(const std::string&, const Options&);
+    std::string search(const Target&, LazyDfa*, std::string&) const;
+    Options options;
+    LiteralSearcher literal;
+    RegexProgram regex;
+    bool useRegex;
+};
+
+LiteralSearcher::LiteralSearcher(const std::string& text, bool foldCase) : needle{text}, ignoreCase{foldCase} {
+    if (ignoreCase) {
+        std::transform(needle.begin(), needle.end(), needle.begin(), lower);
+    }
+}
+
+char LiteralSearcher::lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+bool LiteralSearcher::matchesAt(const char* text) const {
+    if (!ignoreCase) {
+        return std::memcmp(text, needle.data(), needle.size()) == 0;
+    }
+    for (std::size_t i = 0; i < needle.size(); ++i) {
+        if (lower(text[i]) != needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Position of the first occurrence at or after from, or npos.
+std::size_t LiteralSearcher::find(const char* text, std::size_t size, std::size_t from) const {
+    std::size_t length = needle.size();
+    if (length == 0) {
+        return from <= size ? from : npos;
+    }
+    if (length > size) {
+        return npos;
+    }
+    std::size_t last = size - length;
+    std::size_t i = from;
+    if (length == 1 && !ignoreCase) {
+        const void* found = std::memchr(text + i, needle[0], size - std::min(i, size));
+        return found == nullptr ? npos : static_cast<const char*>(found) - text;
+    }
+    char first = needle[0];
+    char end = needle[length - 1];
+    char firstOther = ignoreCase && first >= 'a' && first <= 'z' ? static_cast<char>(first - ('a' - 'A')) : first;
+    char endOther = ignoreCase && end >= 'a' && end <= 'z' ? static_cast<char>(end - ('a' - 'A')) : end;
+#if defined(__AVX2__)
+    const __m256i first32 = _mm256_set1_epi8(first);
+    const __m256i firstOther32 = _mm256_set1_epi8(firstOther);
+    const __m256i end32 = _mm256_set1_epi8(end);
+    const __m256i endOther32 = _mm256_set1_epi8(endOther);
+    for (; i + 32 <= last + 1; i += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + length - 1));
+        __m256i headHit = _mm256_or_si256(_mm256_cmpeq_epi8(head, first32), _mm256_cmpeq_epi8(head, firstOther32));
+        __m256i tailHit = _mm256_or_si256(_mm256_cmpeq_epi8(tail, end32), _mm256_cmpeq_epi8(tail, endOther32));
+        std::uint32_t candidates = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(headHit, tailHit)));
+        for (; candidates != 0; candidates &= candidates - 1) {
+            std::size_t position = i + static_cast<std::size_t>(__builtin_ctz(candidates));
+            if (matchesAt(text + position)) {
+                return position;
+            }
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i first16 = _mm_set1_epi8(first);
+    const __m128i firstOther16 = _mm_set1_epi8(firstOther);
+    const __m128i end16 = _mm_set1_epi8(end);
+    const __m128i endOther16 = _mm_set1_epi8(endOther);
+    for (; i + 16 <= last + 1; i += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + length - 1));
+        __m128i headHit = _mm_or_si128(_mm_cmpeq_epi8(head, first16), _mm_cmpeq_epi8(head, firstOther16));
+        __m128i tailHit = _mm_or_si128(_mm_cmpeq_epi8(tail, end16), _mm_cmpeq_epi8(tail, endOther16));
+        unsigned candidates = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(headHit, tailHit)));
+        for (; candidates != 0; candidates &= candidates - 1) {
+            std::size_t position = i + static_cast<std::size_t>(__builtin_ctz(candidates));
+            if (matchesAt(text + position)) {
+                return position;
+            }
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if ((text[i] == first || text[i] == firstOther) && matchesAt(text + i)) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+Grep::Options::Options()
+    : ignoreCase{false}, lineNumbers{false}, countOnly{false}, filesOnly{false}, extended{false}, fixed{false},
+      showNames{false} {}
+
+unsigned Grep::defaultThreads() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::min(std::max(cores, 1U), 8U);
+}
+
+// A pattern without special characters, apart from escaped ordinary ones, is
+// searched as a fixed string.
+bool Grep::isLiteral(const std::string& pattern, bool extended) {
+    const std::string special = extended ? ".[]*^$+?{}()|" : ".[]*^$";
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '\\') {
+            if (i + 1 == pattern.size() || std::isalnum(static_cast<unsigned char>(pattern[i + 1])) ||
+                std::string("(){}|+?<>`'").find(pattern[i + 1]) != std::string::npos) {
+                return false;
+            }
+            ++i;
+        } else if (special.find(pattern[i]) != std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string Grep::unescape(const std::string& pattern) {
+    std::string text;
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        i += pattern[i] == '\\' ? 1 : 0;
+        text += pattern[i];
+    }
+    return text;
+}
+
+Grep::Grep(const std::string& pattern, const Options& opts)
+    : options{opts},
+      literal{opts.fixed ? pattern : unescape(pattern), opts.ignoreCase},
+      useRegex{!opts.fixed && !isLiteral(pattern, opts.extended)} {}
+
+// The output for one file, built in scratch when the file is not contiguous.
+std::string Grep::search(const Target& target, LazyDfa* dfa, std::string& scratch) const {
+    const char* text = nullptr;
+    std::size_t size = 0;
+    bool contiguous = true;
+    for (std::size_t i = 0; i < target.pieces.size(); ++i) {
+        contiguous = contiguous && (i == 0 || target.pieces[i - 1].data() + target.pieces[i - 1].size() == target.pieces[i].data());
+        size += target.pieces[i].size();
+    }
+    if (contiguous && !target.pieces.empty()) {
+        text = target.pieces[0].data();
+    } else {
+        scratch.clear();
+        scratch.reserve(size);
+        for (std::string_view piece : target.pieces) {
+            scratch.append(piece.data(), piece.size());
+        }
+        text = scratch.data();
+    }
+
+    std::string output;
+    std::uint64_t count = 0;
+    std::uint64_t lineNumber = 1;
+    std::size_t counted = 0;
+    std::string prefix = options.showNames ? target.name + ":" : "";
+    auto report = [&](std::size_t begin, std::size_t end) {
+        ++count;
+        if (options.filesOnly) {
+            return false;
+        }
+        if (options.countOnly) {
+            return true;
+        }
+        output += prefix;
+        if (options.lineNumbers) {
+            lineNumber += static_cast<std::uint64_t>(std::count(text + counted, text + begin, '\n'));
+            counted = begin;
+            output += std::to_string(lineNumber) + ":";
+        }
+        output.append(text + begin, end - begin);
+        output += '\n';
+        return true;
+    };
+    if (useRegex) {
+        dfa->searchLines(text, size, report);
+    } else {
+        std::size_t from = 0;
+        std::size_t position;
+        while (from < size && (position = literal.find(text, size, from)) != LiteralSearcher::npos) {
+            // from is always the start of a line, so the match's line begins
+            // after the last newline between them.
+            std::size_t begin = position;
+            while (begin > from && text[begin - 1] != '\n') {
+                --begin;
+            }
+            const void* newline = std::memchr(text + position, '\n', size - position);
+            std::size_t end = newline == nullptr ? size : static_cast<const char*>(newline) - text;
+            if (!report(begin, end)) {
+                break;
+            }
+            from = end + 1;
+        }
+    }
+    if (options.filesOnly) {
+        return count > 0 ? target.name + "\n" : "";
+    }
+    if (options.countOnly) {
+        return prefix + std::to_string(count) + "\n";
+    }
+    return output;
+}
+
+// Searches targets for pattern with up to threads threads and writes the
+// results to out in the order of targets. Returns false if the pattern does
+// not compile.
+bool Grep::run(const std::string& pattern, const std::vector<Target>& targets, const Options& options, unsigned threads,
+               std::ostream& out, std::string& error) {
+    Grep grep(pattern, options);
+    if (grep.useRegex && !grep.regex.compile(pattern, options.extended, options.ignoreCase, error)) {
+        return false;
+    }
+    threads = std::max(1U, std::min<unsigned>(threads, static_cast<unsigned>(targets.size())));
+    if (threads == 1) {
+        std::unique_ptr<LazyDfa> dfa(grep.useRegex ? new LazyDfa(grep.regex) : nullptr);
+        std::string scratch;
+        for (const Target& target : targets) {
+            out << grep.search(target, dfa.get(), scratch);
+        }
+        return true;
+    }
+    std::vector<std::string> outputs(targets.size());
+    std::vector<char> done(targets.size(), 0);
+    std::atomic<std::size_t> nextTarget{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    auto work = [&]() {
+        std::unique_ptr<LazyDfa> dfa(grep.useRegex ? new LazyDfa(grep.regex) : nullptr);
+        std::string scratch;
+        for (std::size_t i = nextTarget++; i < targets.size(); i = nextTarget++) {
+            std::string result = grep.search(targets[i], dfa.get(), scratch);
+            std::lock_guard<std::mutex> lock(mutex);
+            outputs[i] = std::move(result);
+            done[i] = 1;
+            finished.notify_one();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; ++i) {
+        pool.emplace_back(work);
+    }
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        std::string result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]() { return done[i] != 0; });
+            result = std::move(outputs[i]);
+        }
+        out << result;
+    }
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+    return true;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_GREP_H
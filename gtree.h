@@ -1,181 +1,878 @@
-#ifndef LINUX_EMULATOR_GTREE_H
-#define LINUX_EMULATOR_GTREE_H
-
-#include "file.h"
-
-#include <iostream>
-#include <vector>
-
-namespace LinuxEmulator {
-
-struct Node {
-    File data;
-    Node* parent;
-    std::vector<Node*> children;
-    Node(const File&);
-    Node* getParent() const;
-    void addChild(Node*);
-    ~Node();
-    bool operator==(const Node&) const;
-    void removeChild(Node*);
-};
-
-class GeneralTree {
-private:
-    Node* root;
-    void traverseHelper(Node*);
-public:
-    GeneralTree();
-    bool operator==(const GeneralTree&) const;
-    Node* getRoot() const;
-    void setRoot(Node*);
-    File getRootData() const;
-    void setRootData(const File&);
-    std::vector<Node*> getChildren(Node*) const;
-    void setParent(Node*, Node*);
-    void insert(Node*, Node*);
-    void insert(const File&, const File&);
-    void remove(Node*);
-    void traverse();
-};
-
-Node::Node(const File& f) : data{f} {}
-
-Node::~Node() {
-    for (Node* child : children) {
-        delete child;
-    }
-}
-
-Node* Node::getParent() const {
-    return parent;
-}
-
-bool Node::operator==(const Node& other) const {
-    return data.getName() == other.data.getName() && parent == other.parent && children == other.children;
-}
-
-void Node::addChild(Node* n) {
-    children.push_back(n);
-}
-
-void Node::removeChild(Node* childNode) {
-    auto it = std::find(children.begin(), children.end(), childNode);
-    if (it != children.end()) {
-        children.erase(it);
-    }
-}
-
-GeneralTree::GeneralTree() : root(nullptr) {}
-
-void GeneralTree::traverseHelper(Node* node) {
-    if (node == nullptr)
-        return;
-    std::cout << node->data.getName() << " ";
-    for (Node* child : node->children)
-        traverseHelper(child);
-}
-    
-bool GeneralTree::operator==(const GeneralTree& other) const {
-    return root == nullptr && other.root == nullptr
-           || (root != nullptr && other.root != nullptr && *root == *other.root);
-}
-
-Node* GeneralTree::getRoot() const {
-    return root;
-}
-
-void GeneralTree::setRoot(Node* r) {
-    root = r;
-}
-
-File GeneralTree::getRootData() const {
-    return root->data;
-}
-void GeneralTree::setRootData(const File& d) {
-    if (root == nullptr) {
-        root = new Node(d);
-    } else {
-        root->data = d;
-    }
-}
-
-std::vector<Node*> GeneralTree::getChildren(Node* node) const {
-    return node->children;
-}
-
-void GeneralTree::setParent(Node* child, Node* parent) {
-    child->parent = parent;
-}
-
-void GeneralTree::insert(Node* parentNode, Node* childNode) {
-    childNode->parent = parentNode;
-    parentNode->children.push_back(childNode);
-}
-
-void GeneralTree::insert(const File& parentData, const File& data) {
-    Node* newNode = new Node(data);
-    if (root == nullptr) {
-        root = newNode;
-        return;
-    }
-    std::vector<Node*> nodesQueue;
-    nodesQueue.push_back(root);
-    while (!nodesQueue.empty()) {
-        Node* curr = nodesQueue.front();
-        nodesQueue.erase(nodesQueue.begin());
-        if (curr->data.getName() == parentData.getName()) {
-            curr->children.push_back(newNode);
-            return;
-        }
-        for (Node* child : curr->children)
-            nodesQueue.push_back(child);
-    }
-    delete newNode;
-    std::cout << "Parent node not found. Node " << data.getName() << " was not inserted." << std::endl;
-}
-
-void GeneralTree::remove(Node* node) {
-    if (root == nullptr) {
-        std::cout << "Tree is empty." << std::endl;
-        return;
-    }
-
-    if (root == node) {
-        delete root;
-        root = nullptr;
-        return;
-    }
-
-    std::vector<Node*> nodesQueue;
-    nodesQueue.push_back(root);
-    while (!nodesQueue.empty()) {
-        Node* curr = nodesQueue.front();
-        nodesQueue.erase(nodesQueue.begin());
-        for (size_t i = 0; i < curr->children.size(); i++) {
-            if (curr->children[i] == node) {
-                Node* removedNode = curr->children[i];
-                curr->removeChild(node);
-                delete removedNode;
-                return;
-            }
-            nodesQueue.push_back(curr->children[i]);
-        }
-    }
-    std::cout << "Node not found. It was not removed." << std::endl;
-}
-
-
-void GeneralTree::traverse() {
-    if (root == nullptr) {
-        std::cout << "Tree is empty." << std::endl;
-        return;
-    }
-    std::cout << "Tree traversal: ";
-    traverseHelper(root);
-    std::cout << std::endl;
-}
-
-} // namespace LinuxEmulator
-
+#ifndef LINUX_EMULATOR_GTREE_H
+#define LINUX_EMULATOR_GTREE_H
+
+#include "file.h"
+#include "inode.h"
+#include "dirindex.h"
+#include "stringpool.h"
+#include "hash.h"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+namespace LinuxEmulator {
+
+// Directory entry: a name in a parent directory bound to an inode (File).
+// Only the name and the parent link are stored; the absolute path is derived
+// on demand, so moving or renaming a directory never touches its descendants.
+// The name points into the tree's StringPool; renames go through GeneralTree.
+// A node can be shared by several versions of the tree (see GeneralTree), so
+// refCount counts the directories and tree roots that refer to it, and the
+// parent link is only trusted right after a walk from the root has set it.
+// Freeing a node clears the parent links that pointed at it.
+// nextLink chains the entries that refer to the same inode, in every version
+// of the tree, into a ring, so the other names of a hard-linked file are
+// found without a walk.
+// hash is a Merkle hash of the whole subtree: the entry's own name and inode
+// fingerprint plus the sum of its children's mixed hashes. bytes and entries
+// total the file sizes and the entries (this one included) of the subtree,
+// kept up to date along the parent chain like hash, so du never rescans.
+struct Node {
+    const std::string* name;
+    File* data;
+    Node* parent;
+    Node* nextLink;
+    std::vector<Node*> children;
+    DirectoryIndex<Node> index;
+    std::uint32_t refCount;
+    std::uint32_t entries;
+    std::uint64_t hash;
+    std::uint64_t bytes;
+    Node(const std::string*, File*);
+    static bool isValidName(const std::string&);
+    const std::string& getName() const;
+    std::string getAbsolutePath() const;
+    Node* getParent() const;
+    Node* findChild(const std::string&) const;
+    void addChild(Node*);
+    bool operator==(const Node&) const;
+    std::size_t childPosition(const Node*) const;
+    void removeChild(Node*);
+    void replaceChild(Node*, Node*);
+    void joinLinks(Node*);
+    void leaveLinks();
+};
+
+// Allocator, name pool and inode table behind a tree and all of its copies.
+struct TreeStorage {
+    SlabAllocator allocator;
+    StringPool names;
+    BlobStore blobs;
+    InodeTable inodes;
+    std::size_t nodeCount;
+    unsigned long long copiedNodes;
+    // Taken by the foreground and the reclaimer (see reclaim.h).
+    std::recursive_mutex lock;
+    std::atomic<unsigned> lockWaiters;
+    TreeStorage();
+};
+
+// Nodes and inode records are carved out of a slab allocator, and subtrees
+// are released back to it in one batch rather than through per-node delete.
+// Copying a tree is O(1): the copy takes a reference on the same root, and
+// both sides stay persistent by copying on write. Before a node is modified,
+// makeWritable() walks to it from the root and replaces every node on that
+// path that is still shared with another copy, so an update costs the length
+// of the path while untouched subtrees stay shared.
+class GeneralTree {
+private:
+    friend class TreeImage;
+    Node* root;
+    std::shared_ptr<TreeStorage> storage;
+    void traverseHelper(Node*);
+    Node* unshare(Node*, Node*);
+    void setData(Node*, File*, Node*);
+    bool isReachable(const Node*) const;
+    bool isOwned(const Node*) const;
+    File* moveToCopy(const std::vector<Node*>&);
+    void setName(Node*, const std::string&);
+    static std::uint64_t entryHash(const std::string&, const File*);
+    static void propagateHash(Node*, std::uint64_t);
+    static std::uint64_t ownBytes(const File*);
+    static void propagateUsage(Node*, std::int64_t, std::int64_t);
+    static void diffHelper(const Node*, const Node*, const std::string&, std::vector<std::string>&);
+public:
+    GeneralTree();
+    GeneralTree(const GeneralTree&);
+    GeneralTree& operator=(const GeneralTree&);
+    ~GeneralTree();
+    Node* createNode(const std::string&, const File&);
+    Node* createLink(const std::string&, File*, Node* = nullptr);
+    bool operator==(const GeneralTree&) const;
+    Node* getRoot() const;
+    void setRoot(Node*);
+    File getRootData() const;
+    void setRootData(const File&);
+    std::vector<Node*> getChildren(Node*) const;
+    void setParent(Node*, Node*);
+    Node* makeWritable(const std::string&);
+    File* makeDataWritable(Node*);
+    std::vector<Node*> findLinks(Node*, int);
+    void settleLinks(const std::vector<Node*>&);
+    static void release(TreeStorage&, Node*);
+    void updateData(Node*, std::uint64_t);
+    std::vector<std::string> diff(const GeneralTree&) const;
+    void insert(Node*, Node*);
+    Node* insert(Node*, const std::string&, const File&);
+    Node* link(Node*, const std::string&, Node*);
+    Node* clone(const Node*, const std::string&, bool);
+    void detach(Node*);
+    Node* unlink(Node*);
+    void move(Node*, Node*, const std::string&);
+    void rename(Node*, const std::string&);
+    bool isAncestor(const Node*, const Node*) const;
+    void remove(Node*);
+    void traverse();
+    std::size_t getInodeCount() const;
+    std::size_t getNodeCount() const;
+    unsigned long long getCopiedNodes() const;
+    const SlabAllocator& getAllocator() const;
+    const StringPool& getNames() const;
+    const BlobStore& getBlobs() const;
+    BlobStore& getBlobs();
+    std::shared_ptr<TreeStorage> getStorage() const;
+};
+
+Node::Node(const std::string* n, File* f)
+    : name{n}, data{f}, parent{nullptr}, nextLink{this}, refCount{0}, entries{1}, hash{0}, bytes{0} {}
+// Whether name can be an entry of a directory: "." and ".." are the
+// directory's own links and '/' separates path components.
+bool Node::isValidName(const std::string& name) {
+    return !name.empty() && name != "." && name != ".." && name.find('/') == std::string::npos;
+}
+
+const std::string& Node::getName() const {
+    return *name;
+}
+
+std::string Node::getAbsolutePath() const {
+    if (parent == nullptr) {
+        return "/";
+    }
+    // Two walks up the parent chain: one to size the path, one to fill it in
+    // from the end, so the string is the only allocation.
+    std::size_t length = 0;
+    for (const Node* curr = this; curr->parent != nullptr; curr = curr->parent) {
+        length += curr->name->size() + 1;
+    }
+    std::string path(length, '/');
+    for (const Node* curr = this; curr->parent != nullptr; curr = curr->parent) {
+        length -= curr->name->size();
+        curr->name->copy(&path[length], curr->name->size());
+        --length;
+    }
+    return path;
+}
+
+Node* Node::getParent() const {
+    return parent;
+}
+
+Node* Node::findChild(const std::string& childName) const {
+    if (index.isActive()) {
+        return index.find(childName);
+    }
+    for (Node* child : children) {
+        if (*child->name == childName) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+bool Node::operator==(const Node& other) const {
+    return hash == other.hash && *name == *other.name;
+}
+
+void Node::addChild(Node* n) {
+    children.push_back(n);
+    if (index.isActive()) {
+        index.insert(n, static_cast<std::uint32_t>(children.size() - 1));
+    } else if (children.size() > DirectoryIndex<Node>::inlineThreshold) {
+        index.build(children);
+    }
+}
+
+// Where childNode sits in the child list: from the index when there is one,
+// so that large directories are never searched, or children.size().
+std::size_t Node::childPosition(const Node* childNode) const {
+    std::size_t position = index.isActive() ? index.position(childNode->getName()) : DirectoryIndex<Node>::npos;
+    if (position < children.size() && children[position] == childNode) {
+        return position;
+    }
+    return std::find(children.begin(), children.end(), childNode) - children.begin();
+}
+
+// The last child moves into the hole, so removal is O(1); the order of the
+// child list is not kept.
+void Node::removeChild(Node* childNode) {
+    std::size_t position = childPosition(childNode);
+    if (position == children.size()) {
+        return;
+    }
+    children[position] = children.back();
+    children.pop_back();
+    index.erase(childNode->getName());
+    if (position < children.size()) {
+        index.setPosition(children[position]->getName(), static_cast<std::uint32_t>(position));
+    }
+}
+
+void Node::replaceChild(Node* oldChild, Node* newChild) {
+    std::size_t position = childPosition(oldChild);
+    if (position == children.size()) {
+        return;
+    }
+    children[position] = newChild;
+    if (index.erase(oldChild->getName())) {
+        index.insert(newChild, static_cast<std::uint32_t>(position));
+    }
+}
+
+// Adds this node, alone in its ring, to the ring of sibling, an entry that
+// refers to the same inode.
+void Node::joinLinks(Node* sibling) {
+    nextLink = sibling->nextLink;
+    sibling->nextLink = this;
+}
+
+// Takes this node out of its ring. Rings are as long as the inode has
+// entries in all versions of the tree, which is short.
+void Node::leaveLinks() {
+    Node* previous = this;
+    while (previous->nextLink != this) {
+        previous = previous->nextLink;
+    }
+    previous->nextLink = nextLink;
+    nextLink = this;
+}
+
+TreeStorage::TreeStorage() : inodes(allocator, blobs), nodeCount{0}, copiedNodes{0}, lockWaiters{0} {}
+
+GeneralTree::GeneralTree() : root(nullptr), storage(std::make_shared<TreeStorage>()) {}
+
+GeneralTree::GeneralTree(const GeneralTree& other) : root(other.root), storage(other.storage) {
+    if (root != nullptr) {
+        ++root->refCount;
+    }
+}
+
+GeneralTree& GeneralTree::operator=(const GeneralTree& other) {
+    // Take the new reference first so that self-assignment is harmless.
+    if (other.root != nullptr) {
+        ++other.root->refCount;
+    }
+    if (root != nullptr) {
+        release(*storage, root);
+    }
+    root = other.root;
+    storage = other.storage;
+    return *this;
+}
+
+GeneralTree::~GeneralTree() {
+    if (root != nullptr) {
+        release(*storage, root);
+    }
+}
+
+Node* GeneralTree::createNode(const std::string& name, const File& data) {
+    File* inode = storage->inodes.allocate(data);
+    inode->setLinkCount(1);
+    return createLink(name, inode);
+}
+
+// A new entry for inode; sibling is an entry that already refers to it, if
+// there is one.
+Node* GeneralTree::createLink(const std::string& name, File* inode, Node* sibling) {
+    storage->inodes.retain(inode);
+    ++storage->nodeCount;
+    Node* node = new (storage->allocator.allocate(sizeof(Node))) Node(storage->names.intern(name), inode);
+    if (sibling != nullptr) {
+        node->joinLinks(sibling);
+    }
+    node->hash = entryHash(name, inode);
+    node->bytes = ownBytes(inode);
+    return node;
+}
+
+std::uint64_t GeneralTree::entryHash(const std::string& name, const File* inode) {
+    return mixHash(hashBytes(name.data(), name.size())) + inode->getHash();
+}
+
+// Sets node's subtree hash and carries the change up the parent chain. Each
+// level only swaps one mixed term of the sum, so the cost is the depth. The
+// chain must already be writable.
+void GeneralTree::propagateHash(Node* node, std::uint64_t newHash) {
+    while (node != nullptr && node->hash != newHash) {
+        std::uint64_t oldHash = node->hash;
+        node->hash = newHash;
+        node = node->parent;
+        if (node != nullptr) {
+            newHash = node->hash - mixHash(oldHash) + mixHash(newHash);
+        }
+    }
+}
+
+std::uint64_t GeneralTree::ownBytes(const File* inode) {
+    return inode->getIsDirectory() ? 0 : inode->getSize();
+}
+
+// Adds to the totals of node and of every directory above it. Like
+// propagateHash, the chain must already be writable.
+void GeneralTree::propagateUsage(Node* node, std::int64_t bytes, std::int64_t entries) {
+    for (; node != nullptr && (bytes != 0 || entries != 0); node = node->parent) {
+        node->bytes += static_cast<std::uint64_t>(bytes);
+        node->entries += static_cast<std::uint64_t>(entries);
+    }
+}
+
+// Drops one reference to node. Nodes that were only reachable through it are
+// freed with it; children still referenced by another copy of the tree stay.
+void GeneralTree::release(TreeStorage& store, Node* node) {
+    if (--node->refCount != 0) {
+        return;
+    }
+    SlabAllocator::Batch freedNodes;
+    std::vector<Node*> pending{node};
+    while (!pending.empty()) {
+        Node* curr = pending.back();
+        pending.pop_back();
+        for (Node* child : curr->children) {
+            if (child->parent == curr) {
+                child->parent = nullptr;
+            }
+            if (--child->refCount == 0) {
+                pending.push_back(child);
+            }
+        }
+        curr->leaveLinks();
+        store.inodes.release(curr->data);
+        store.names.release(curr->name);
+        curr->~Node();
+        --store.nodeCount;
+        store.allocator.addToBatch(freedNodes, curr);
+    }
+    store.allocator.deallocateBatch(freedNodes, sizeof(Node));
+}
+
+// Replaces the shared node under parentNode (or the root when parentNode is
+// null) by a private copy. The copy references the same children and inode,
+// so only this one node is duplicated.
+Node* GeneralTree::unshare(Node* parentNode, Node* node) {
+    Node* copy = createLink(*node->name, node->data, node);
+    copy->children = node->children;
+    for (Node* child : copy->children) {
+        ++child->refCount;
+        child->parent = copy;
+    }
+    if (copy->children.size() > DirectoryIndex<Node>::inlineThreshold) {
+        copy->index.build(copy->children);
+    }
+    copy->hash = node->hash;
+    copy->bytes = node->bytes;
+    copy->entries = node->entries;
+    copy->parent = parentNode;
+    if (parentNode == nullptr) {
+        root = copy;
+    } else {
+        parentNode->replaceChild(node, copy);
+        // The original stays in the other versions' directories only.
+        node->parent = nullptr;
+    }
+    ++copy->refCount;
+    --node->refCount;
+    ++storage->copiedNodes;
+    return copy;
+}
+
+Node* GeneralTree::makeWritable(const std::string& path) {
+    if (root == nullptr) {
+        return nullptr;
+    }
+    if (root->refCount > 1) {
+        unshare(nullptr, root);
+    }
+    Node* curr = root;
+    std::string part;
+    std::size_t start = 1;
+    while (start < path.size()) {
+        std::size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        part.assign(path, start, end - start);
+        Node* child = curr->findChild(part);
+        if (child == nullptr) {
+            return nullptr;
+        }
+        child->parent = curr;
+        // Once a parent has been copied its children are shared by the copy
+        // and the original, so everything below it on the path is copied too.
+        curr = child->refCount > 1 ? unshare(curr, child) : child;
+        start = end + 1;
+    }
+    return curr;
+}
+
+// Returns an inode that node (already writable) may modify in place. The
+// record is shared with another copy of the tree whenever it has more
+// references than names in this tree; then every name of it is moved to a
+// private copy.
+File* GeneralTree::makeDataWritable(Node* node) {
+    File* inode = node->data;
+    if (inode->getReferenceCount() <= static_cast<std::uint32_t>(inode->getLinkCount())) {
+        return inode;
+    }
+    if (inode->getLinkCount() <= 1) {
+        File* copy = storage->inodes.clone(inode);
+        setData(node, copy, nullptr);
+        return copy;
+    }
+    return moveToCopy(findLinks(node, inode->getLinkCount()));
+}
+
+// Moves names, all the names of their inode in this tree, to a private copy
+// of it and returns the copy.
+File* GeneralTree::moveToCopy(const std::vector<Node*>& names) {
+    File* copy = storage->inodes.clone(names.front()->data);
+    // Paths first: making one name writable may copy nodes of the others.
+    std::vector<std::string> linkPaths;
+    for (Node* link : names) {
+        linkPaths.push_back(link->getAbsolutePath());
+    }
+    Node* first = nullptr;
+    for (const std::string& linkPath : linkPaths) {
+        Node* link = makeWritable(linkPath);
+        setData(link, copy, first);
+        first = first == nullptr ? link : first;
+    }
+    // Names unlinked with their subtree still waiting for the reclaimer are
+    // not in the tree any more, and do not count for the copy.
+    copy->setLinkCount(static_cast<int>(linkPaths.size()));
+    return copy;
+}
+
+// Sets the link count of the inode of names, all the names it has left in
+// this tree, to their number. Used once the other names are gone without
+// the inode being written (see Reclaimer); an inode another version still
+// sees is moved to a copy instead.
+void GeneralTree::settleLinks(const std::vector<Node*>& names) {
+    if (names.empty()) {
+        return;
+    }
+    File* inode = names.front()->data;
+    bool owned = inode->getReferenceCount() <= names.size();
+    for (std::size_t i = 0; owned && i < names.size(); ++i) {
+        owned = isOwned(names[i]);
+    }
+    if (owned) {
+        inode->setLinkCount(static_cast<int>(names.size()));
+    } else {
+        moveToCopy(names);
+    }
+}
+
+// Called after the inode of node (already writable) has changed; oldHash is
+// the inode's fingerprint from before the change. New content is interned,
+// and every name of the inode gets the new hash; for hard links only the
+// paths above those names are updated.
+void GeneralTree::updateData(Node* node, std::uint64_t oldHash) {
+    node->data->internContent(storage->blobs);
+    std::uint64_t delta = node->data->getHash() - oldHash;
+    // A file's node has no children, so its total is the old size. A
+    // directory's total is its subtree's, which metadata changes leave alone.
+    std::int64_t growth = node->data->getIsDirectory() ? 0 :
+        static_cast<std::int64_t>(ownBytes(node->data)) - static_cast<std::int64_t>(node->bytes);
+    if (delta == 0 && growth == 0) {
+        return;
+    }
+    if (node->data->getLinkCount() <= 1) {
+        propagateHash(node, node->hash + delta);
+        propagateUsage(node, growth, 0);
+        return;
+    }
+    for (Node* link : findLinks(node, node->data->getLinkCount())) {
+        propagateHash(link, link->hash + delta);
+        propagateUsage(link, growth, 0);
+    }
+}
+
+// Whether node is in this tree: its parent links lead to the root through
+// directories that really hold it.
+bool GeneralTree::isReachable(const Node* node) const {
+    for (const Node* curr = node; curr != root; curr = curr->parent) {
+        if (curr->parent == nullptr || curr->parent->childPosition(curr) == curr->parent->children.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether node is in no other version of the tree: neither it nor any
+// directory above it is shared.
+bool GeneralTree::isOwned(const Node* node) const {
+    for (const Node* curr = node; curr != nullptr; curr = curr->parent) {
+        if (curr->refCount != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The names in this tree of node's inode, which node itself need not be one
+// of; links is how many there should be. The inode's ring holds its entries
+// in every version of the tree, and those reachable from this root are the
+// names. Should they not account for links (a parent link is stale after a
+// restored snapshot, or names wait for the reclaimer), one walk from the
+// root finds them instead and sets the parent links on the way.
+std::vector<Node*> GeneralTree::findLinks(Node* node, int links) {
+    std::vector<Node*> names;
+    Node* member = node;
+    do {
+        if (isReachable(member)) {
+            names.push_back(member);
+        }
+        member = member->nextLink;
+    } while (member != node);
+    if (names.size() == static_cast<std::size_t>(links)) {
+        return names;
+    }
+    names.clear();
+    std::vector<Node*> pending{root};
+    while (!pending.empty()) {
+        Node* curr = pending.back();
+        pending.pop_back();
+        for (Node* child : curr->children) {
+            child->parent = curr;
+            if (child->data == node->data) {
+                names.push_back(child);
+            } else if (!child->children.empty()) {
+                pending.push_back(child);
+            }
+        }
+    }
+    return names;
+}
+
+// Paths at which two trees differ, found by descending only into subtrees
+// whose hashes differ. "-" marks entries only in this tree, "+" entries only
+// in other, and "~" entries present in both with a different type,
+// permission set or content.
+std::vector<std::string> GeneralTree::diff(const GeneralTree& other) const {
+    std::vector<std::string> differences;
+    if (root != nullptr && other.root != nullptr) {
+        diffHelper(root, other.root, "", differences);
+    }
+    return differences;
+}
+
+void GeneralTree::diffHelper(const Node* mine, const Node* theirs, const std::string& path, 
+                             std::vector<std::string>& differences) {
+    if (mine->hash == theirs->hash) {
+        return;
+    }
+    if (mine->data->getHash() != theirs->data->getHash()) {
+        differences.push_back("~ " + (path.empty() ? std::string("/") : path));
+    }
+    for (const Node* child : mine->children) {
+        std::string childPath = path + "/" + child->getName();
+        const Node* match = theirs->findChild(child->getName());
+        if (match == nullptr) {
+            differences.push_back("- " + childPath);
+        } else {
+            diffHelper(child, match, childPath, differences);
+        }
+    }
+    for (const Node* child : theirs->children) {
+        if (mine->findChild(child->getName()) == nullptr) {
+            differences.push_back("+ " + path + "/" + child->getName());
+        }
+    }
+}
+
+// Points node at inode, moving it to the ring of sibling (another entry of
+// inode) or to a ring of its own.
+void GeneralTree::setData(Node* node, File* inode, Node* sibling) {
+    storage->inodes.retain(inode);
+    storage->inodes.release(node->data);
+    node->data = inode;
+    node->leaveLinks();
+    if (sibling != nullptr) {
+        node->joinLinks(sibling);
+    }
+}
+
+std::size_t GeneralTree::getInodeCount() const {
+    return storage->inodes.size();
+}
+
+std::size_t GeneralTree::getNodeCount() const {
+    return storage->nodeCount;
+}
+
+unsigned long long GeneralTree::getCopiedNodes() const {
+    return storage->copiedNodes;
+}
+
+const StringPool& GeneralTree::getNames() const {
+    return storage->names;
+}
+
+const BlobStore& GeneralTree::getBlobs() const {
+    return storage->blobs;
+}
+
+BlobStore& GeneralTree::getBlobs() {
+    return storage->blobs;
+}
+
+std::shared_ptr<TreeStorage> GeneralTree::getStorage() const {
+    return storage;
+}
+
+const SlabAllocator& GeneralTree::getAllocator() const {
+    return storage->allocator;
+}
+
+void GeneralTree::traverseHelper(Node* node) {
+    if (node == nullptr)
+        return;
+    std::cout << node->getName() << " ";
+    for (Node* child : node->children)
+        traverseHelper(child);
+}
+    
+// Root hashes cover the whole tree, so equality does not walk it.
+bool GeneralTree::operator==(const GeneralTree& other) const {
+    if (root == nullptr || other.root == nullptr) {
+        return root == other.root;
+    }
+    return root->hash == other.root->hash;
+}
+
+Node* GeneralTree::getRoot() const {
+    return root;
+}
+
+void GeneralTree::setRoot(Node* r) {
+    ++r->refCount;
+    if (root != nullptr) {
+        release(*storage, root);
+    }
+    root = r;
+}
+
+File GeneralTree::getRootData() const {
+    return *root->data;
+}
+void GeneralTree::setRootData(const File& d) {
+    if (root == nullptr) {
+        setRoot(createNode("/", d));
+    } else {
+        Node* writableRoot = makeWritable("/");
+        File* inode = makeDataWritable(writableRoot);
+        std::uint64_t oldHash = inode->getHash();
+        *inode = d;
+        updateData(writableRoot, oldHash);
+    }
+}
+
+std::vector<Node*> GeneralTree::getChildren(Node* node) const {
+    return node->children;
+}
+
+void GeneralTree::setParent(Node* child, Node* parent) {
+    child->parent = parent;
+}
+
+void GeneralTree::insert(Node* parentNode, Node* childNode) {
+    childNode->parent = parentNode;
+    parentNode->addChild(childNode);
+    ++childNode->refCount;
+    propagateHash(parentNode, parentNode->hash + mixHash(childNode->hash));
+    propagateUsage(parentNode, static_cast<std::int64_t>(childNode->bytes), static_cast<std::int64_t>(childNode->entries));
+}
+
+// Handle-based operations: callers pass the Node they already resolved, and
+// the parent link replaces any search from the root, so each call costs O(1)
+// plus the update of the parent's child list. Nodes and inodes passed in must
+// have been made writable first.
+Node* GeneralTree::insert(Node* parentNode, const std::string& name, const File& data) {
+    Node* newNode = createNode(name, data);
+    insert(parentNode, newNode);
+    return newNode;
+}
+
+// A new name for the inode of target, whose inode must be writable.
+Node* GeneralTree::link(Node* parentNode, const std::string& name, Node* target) {
+    File* inode = target->data;
+    inode->setLinkCount(inode->getLinkCount() + 1);
+    Node* newNode = createLink(name, inode, target);
+    insert(parentNode, newNode);
+    return newNode;
+}
+
+// Copies the subtree under source into a new, detached subtree called name,
+// to be attached with insert(). The nodes come from the allocator in one
+// batch sized by source's entry total, and hashes and usage totals are
+// carried over rather than recomputed. Every entry gets an inode of its own
+// with the same mode, sharing the content blob, so no bytes are copied until
+// one side writes. With preserve (cp -a) times, owners and the hard links
+// between entries of the subtree are kept too; otherwise (cp -r) the copies
+// are new files dated now.
+Node* GeneralTree::clone(const Node* source, const std::string& name, bool preserve) {
+    SlabAllocator::Batch nodes;
+    storage->allocator.allocateBatch(nodes, sizeof(Node), source->entries);
+    std::unordered_map<const File*, Node*> linked;
+    auto copyEntry = [&](const Node* original, const std::string& entryName) {
+        const File* data = original->data;
+        bool hardLinked = preserve && !data->getIsDirectory() && data->getLinkCount() > 1;
+        auto found = hardLinked ? linked.find(data) : linked.end();
+        Node* sibling = found != linked.end() ? found->second : nullptr;
+        File* inode = sibling != nullptr ? sibling->data : nullptr;
+        if (inode == nullptr && preserve) {
+            inode = storage->inodes.allocate(*data);
+        } else if (inode == nullptr) {
+            File fresh(nullptr, data->getPermissions(), data->getIsDirectory());
+            fresh.shareContent(*data);
+            inode = storage->inodes.allocate(fresh);
+        }
+        inode->setLinkCount(inode->getLinkCount() + 1);
+        storage->inodes.retain(inode);
+        ++storage->nodeCount;
+        void* memory = nodes.head != nullptr ? storage->allocator.takeFromBatch(nodes) : storage->allocator.allocate(sizeof(Node));
+        Node* node = new (memory) Node(storage->names.intern(entryName), inode);
+        if (sibling != nullptr) {
+            node->joinLinks(sibling);
+        } else if (hardLinked) {
+            linked.emplace(data, node);
+        }
+        // Neither the name nor the fingerprint changes below the top.
+        node->hash = original->hash;
+        node->bytes = original->bytes;
+        node->entries = original->entries;
+        return node;
+    };
+    Node* top = copyEntry(source, name);
+    top->hash += entryHash(name, top->data) - entryHash(source->getName(), source->data);
+    std::vector<std::pair<const Node*, Node*>> pending{{source, top}};
+    while (!pending.empty()) {
+        const Node* original = pending.back().first;
+        Node* copy = pending.back().second;
+        pending.pop_back();
+        copy->children.reserve(original->children.size());
+        for (const Node* child : original->children) {
+            Node* childCopy = copyEntry(child, child->getName());
+            childCopy->parent = copy;
+            childCopy->refCount = 1;
+            copy->children.push_back(childCopy);
+            if (!child->children.empty()) {
+                pending.emplace_back(child, childCopy);
+            }
+        }
+        if (copy->children.size() > DirectoryIndex<Node>::inlineThreshold) {
+            copy->index.build(copy->children);
+        }
+    }
+    storage->allocator.deallocateBatch(nodes, sizeof(Node));
+    return top;
+}
+
+void GeneralTree::detach(Node* node) {
+    if (node->parent != nullptr) {
+        Node* parentNode = node->parent;
+        parentNode->removeChild(node);
+        node->parent = nullptr;
+        --node->refCount;
+        propagateHash(parentNode, parentNode->hash - mixHash(node->hash));
+        propagateUsage(parentNode, -static_cast<std::int64_t>(node->bytes), -static_cast<std::int64_t>(node->entries));
+    }
+}
+
+// Like detach(), but the parent's reference on node is handed to the caller,
+// who frees the subtree later (see Reclaimer).
+Node* GeneralTree::unlink(Node* node) {
+    ++node->refCount;
+    detach(node);
+    return node;
+}
+
+void GeneralTree::move(Node* node, Node* newParent, const std::string& newName) {
+    detach(node);
+    node->hash += entryHash(newName, node->data) - entryHash(node->getName(), node->data);
+    setName(node, newName);
+    insert(newParent, node);
+}
+
+void GeneralTree::setName(Node* node, const std::string& newName) {
+    const std::string* oldName = node->name;
+    node->name = storage->names.intern(newName);
+    storage->names.release(oldName);
+}
+
+bool GeneralTree::isAncestor(const Node* ancestor, const Node* node) const {
+    for (const Node* curr = node; curr != nullptr; curr = curr->parent) {
+        if (curr == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void GeneralTree::rename(Node* node, const std::string& newName) {
+    // The parent's index is keyed by name, so re-key the entry in place; the
+    // node keeps its position in the child list.
+    std::uint64_t newHash = node->hash - entryHash(node->getName(), node->data) + entryHash(newName, node->data);
+    std::uint32_t position = DirectoryIndex<Node>::npos;
+    if (node->parent != nullptr) {
+        position = node->parent->index.position(node->getName());
+        node->parent->index.erase(node->getName());
+    }
+    setName(node, newName);
+    if (node->parent != nullptr) {
+        node->parent->index.insert(node, position);
+    }
+    propagateHash(node, newHash);
+}
+
+void GeneralTree::remove(Node* node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node == root) {
+        root = nullptr;
+        release(*storage, node);
+        return;
+    }
+    if (node->parent != nullptr) {
+        Node* parentNode = node->parent;
+        parentNode->removeChild(node);
+        node->parent = nullptr;
+        propagateHash(parentNode, parentNode->hash - mixHash(node->hash));
+        propagateUsage(parentNode, -static_cast<std::int64_t>(node->bytes), -static_cast<std::int64_t>(node->entries));
+    }
+    release(*storage, node);
+}
+
+void GeneralTree::traverse() {
+    if (root == nullptr) {
+        std::cout << "Tree is empty." << std::endl;
+        return;
+    }
+    std::cout << "Tree traversal: ";
+    traverseHelper(root);
+    std::cout << std::endl;
+}
+
+} // namespace LinuxEmulator
+
 #endif // LINUX_EMULATOR_GTREE_H
\ No newline at end of file
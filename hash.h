@@ -0,0 +1,31 @@
+#ifndef LINUX_EMULATOR_HASH_H
+#define LINUX_EMULATOR_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LinuxEmulator {
+
+// 64-bit FNV-1a over a byte range. Passing the hash of a prefix as seed
+// continues it, so appended bytes can be hashed on their own.
+inline std::uint64_t hashBytes(const char* bytes, std::size_t length, std::uint64_t seed = 0xcbf29ce484222325ULL) {
+    std::uint64_t hash = seed;
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(bytes[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer. Subtree hashes are sums of mixed child hashes, and
+// the mixing keeps those sums from cancelling when entries move around.
+inline std::uint64_t mixHash(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_HASH_H
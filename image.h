@@ -0,0 +1,382 @@
+#ifndef LINUX_EMULATOR_IMAGE_H
+#define LINUX_EMULATOR_IMAGE_H
+
+#include "gtree.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Binary image of a GeneralTree that is used in place through mmap:
+//
+//   header | node table | inode table | string pool | content blobs
+//
+// Integers are in host byte order, and byteOrder lets a reader on another
+// architecture reject the image. Nodes are stored parents first together
+// with their Merkle hashes, so loading is a single pass that hangs each node
+// under an already created parent without hashing anything. Each content
+// blob is stored once, 8-byte aligned, and a loaded tree reads the bytes
+// straight from the mapping; a file's content is copied out of it only when
+// the file is first written. The mapping stays alive as long as any tree or
+// snapshot still refers to one of its blobs.
+class TreeImage {
+public:
+    static const std::uint32_t currentVersion = 1;
+    TreeImage(const TreeImage&) = delete;
+    TreeImage& operator=(const TreeImage&) = delete;
+    ~TreeImage();
+    static bool save(const GeneralTree&, const std::string&, std::size_t&, std::string&);
+    static bool load(const std::string&, GeneralTree&, std::size_t&, std::string&);
+private:
+    static const std::uint32_t noParent = 0xffffffff;
+    static const std::uint32_t byteOrderMark = 0x01020304;
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byteOrder;
+        std::uint64_t nodeCount;
+        std::uint64_t inodeCount;
+        std::uint64_t nodesOffset;
+        std::uint64_t inodesOffset;
+        std::uint64_t stringsOffset;
+        std::uint64_t stringsSize;
+        std::uint64_t contentOffset;
+        std::uint64_t contentSize;
+    };
+    struct NodeRecord {
+        std::uint32_t parent;
+        std::uint32_t inode;
+        std::uint32_t nameOffset;
+        std::uint32_t nameLength;
+        std::uint64_t hash;
+    };
+    struct InodeRecord {
+        std::uint64_t contentOffset;
+        std::uint64_t contentLength;
+        std::uint64_t contentHash;
+        std::int64_t modifiedTime;
+        std::int64_t changeTime;
+        std::uint32_t linkCount;
+        std::uint32_t ownerId;
+        std::uint32_t groupId;
+        std::uint16_t mode;
+        std::uint16_t reserved;
+    };
+    static const char magic[8];
+    static std::uint64_t align(std::uint64_t);
+    static bool inRange(std::uint64_t, std::uint64_t, std::uint64_t);
+    TreeImage(const char*, std::size_t);
+    bool validate(std::string&) const;
+    const char* data;
+    std::size_t size;
+};
+
+const char TreeImage::magic[8] = {'L', 'E', 'M', 'U', 'I', 'M', 'G', '\0'};
+
+TreeImage::TreeImage(const char* d, std::size_t s) : data{d}, size{s} {}
+
+TreeImage::~TreeImage() {
+    munmap(const_cast<char*>(data), size);
+}
+
+std::uint64_t TreeImage::align(std::uint64_t offset) {
+    return (offset + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+// Whether [offset, offset + length) lies within [0, limit), without overflow.
+bool TreeImage::inRange(std::uint64_t offset, std::uint64_t length, std::uint64_t limit) {
+    return offset <= limit && length <= limit - offset;
+}
+
+// Writes the image next to path and renames it into place, so that a tree
+// still mapped from an earlier image at path keeps reading the old file.
+// entries is set to the number of entries written.
+bool TreeImage::save(const GeneralTree& tree, const std::string& path, std::size_t& entries, std::string& error) {
+    // Breadth-first order puts every parent before its children. Parent
+    // links of shared nodes may be stale, so the walk records its own.
+    std::vector<const Node*> nodes{tree.getRoot()};
+    std::vector<std::uint32_t> parents{noParent};
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        for (const Node* child : nodes[i]->children) {
+            nodes.push_back(child);
+            parents.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+    std::vector<NodeRecord> nodeRecords;
+    std::vector<InodeRecord> inodeRecords;
+    std::unordered_map<const File*, std::uint32_t> inodeIndex;
+    std::unordered_map<const std::string*, std::uint32_t> nameOffsets;
+    std::unordered_map<const char*, std::uint64_t> blobOffsets;
+    std::vector<const ContentBuffer*> blobs;
+    std::string strings;
+    std::uint64_t contentSize = 0;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        const Node* node = nodes[i];
+        auto inode = inodeIndex.emplace(node->data, static_cast<std::uint32_t>(inodeRecords.size()));
+        if (inode.second) {
+            const File* file = node->data;
+            const ContentBuffer& content = file->getContent();
+            // Buffers sharing a blob share its first extent.
+            const char* blob = content.empty() ? nullptr : content.chunk(0).data();
+            auto stored = blobOffsets.emplace(blob, contentSize);
+            if (stored.second && blob != nullptr) {
+                blobs.push_back(&content);
+                contentSize = align(contentSize + content.size());
+            }
+            inodeRecords.push_back(InodeRecord{stored.first->second, content.size(), file->contentHash,
+                                               file->modifiedTime, file->changeTime, file->linkCount,
+                                               file->ownerId, file->groupId, file->mode, 0});
+        }
+        auto name = nameOffsets.emplace(node->name, static_cast<std::uint32_t>(strings.size()));
+        if (name.second) {
+            strings += *node->name;
+        }
+        if (strings.size() > noParent) {
+            error = "string pool too large";
+            return false;
+        }
+        nodeRecords.push_back(NodeRecord{parents[i], inode.first->second, name.first->second,
+                                         static_cast<std::uint32_t>(node->name->size()), node->hash});
+    }
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = currentVersion;
+    header.byteOrder = byteOrderMark;
+    header.nodeCount = nodeRecords.size();
+    header.inodeCount = inodeRecords.size();
+    header.nodesOffset = align(sizeof(Header));
+    header.inodesOffset = align(header.nodesOffset + nodeRecords.size() * sizeof(NodeRecord));
+    header.stringsOffset = align(header.inodesOffset + inodeRecords.size() * sizeof(InodeRecord));
+    header.stringsSize = strings.size();
+    header.contentOffset = align(header.stringsOffset + strings.size());
+    header.contentSize = contentSize;
+
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot open " + temporary + " for writing";
+        return false;
+    }
+    auto padTo = [&out](std::uint64_t offset) {
+        static const char zeros[8] = {};
+        std::uint64_t position = static_cast<std::uint64_t>(out.tellp());
+        out.write(zeros, static_cast<std::streamsize>(offset - position));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    padTo(header.nodesOffset);
+    out.write(reinterpret_cast<const char*>(nodeRecords.data()),
+              static_cast<std::streamsize>(nodeRecords.size() * sizeof(NodeRecord)));
+    padTo(header.inodesOffset);
+    out.write(reinterpret_cast<const char*>(inodeRecords.data()),
+              static_cast<std::streamsize>(inodeRecords.size() * sizeof(InodeRecord)));
+    padTo(header.stringsOffset);
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    for (const ContentBuffer* content : blobs) {
+        padTo(align(static_cast<std::uint64_t>(out.tellp())));
+        content->write(out, 0, content->size());
+    }
+    padTo(header.contentOffset + header.contentSize);
+    out.close();
+    if (!out) {
+        error = "write to " + temporary + " failed";
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = "cannot rename " + temporary + " to " + path;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    entries = nodeRecords.size();
+    return true;
+}
+
+// Checks every offset, index and length in the image before anything is
+// built from it, so that a truncated or corrupt file is rejected as a whole.
+// The root must be a directory, and every other name one a directory can
+// hold, once per parent.
+bool TreeImage::validate(std::string& error) const {
+    if (size < sizeof(Header)) {
+        error = "file too small";
+        return false;
+    }
+    const Header& header = *reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        error = "not an image file";
+        return false;
+    }
+    if (header.byteOrder != byteOrderMark) {
+        error = "image was written with a different byte order";
+        return false;
+    }
+    if (header.version != currentVersion) {
+        error = "unsupported image version " + std::to_string(header.version);
+        return false;
+    }
+    if (header.nodeCount == 0 || header.nodeCount >= noParent || header.inodeCount >= noParent ||
+        header.nodesOffset % 8 != 0 || header.inodesOffset % 8 != 0 ||
+        !inRange(header.nodesOffset, header.nodeCount * sizeof(NodeRecord), size) ||
+        !inRange(header.inodesOffset, header.inodeCount * sizeof(InodeRecord), size) ||
+        !inRange(header.stringsOffset, header.stringsSize, size) ||
+        !inRange(header.contentOffset, header.contentSize, size)) {
+        error = "corrupt header";
+        return false;
+    }
+    const InodeRecord* inodes = reinterpret_cast<const InodeRecord*>(data + header.inodesOffset);
+    for (std::uint64_t i = 0; i < header.inodeCount; ++i) {
+        if (!inRange(inodes[i].contentOffset, inodes[i].contentLength, header.contentSize)) {
+            error = "corrupt inode table";
+            return false;
+        }
+    }
+    const NodeRecord* nodes = reinterpret_cast<const NodeRecord*>(data + header.nodesOffset);
+    const char* strings = data + header.stringsOffset;
+    // Nodes already seen, by parent and name, so that no directory is loaded
+    // with two entries of one name. Open addressing over node indexes keeps
+    // this to one allocation.
+    std::size_t capacity = 1;
+    while (capacity < header.nodeCount * 2) {
+        capacity *= 2;
+    }
+    const std::uint32_t unused = noParent;
+    std::vector<std::uint32_t> seen(capacity, unused);
+    for (std::uint64_t i = 0; i < header.nodeCount; ++i) {
+        const NodeRecord& node = nodes[i];
+        bool parentValid = i == 0 ? node.parent == noParent : node.parent < i &&
+                           (inodes[nodes[node.parent].inode].mode & File::typeDirectory) != 0;
+        if (!parentValid || node.inode >= header.inodeCount ||
+            !inRange(node.nameOffset, node.nameLength, header.stringsSize)) {
+            error = "corrupt node table";
+            return false;
+        }
+        if (i == 0) {
+            if ((inodes[node.inode].mode & File::typeDirectory) == 0) {
+                error = "root is not a directory";
+                return false;
+            }
+            continue;
+        }
+        std::string_view name(strings + node.nameOffset, node.nameLength);
+        if (!Node::isValidName(std::string(name))) {
+            error = "invalid entry name";
+            return false;
+        }
+        std::size_t slot = mixHash(hashBytes(name.data(), name.size(), node.parent)) & (capacity - 1);
+        for (; seen[slot] != unused; slot = (slot + 1) & (capacity - 1)) {
+            const NodeRecord& other = nodes[seen[slot]];
+            if (other.parent == node.parent &&
+                name == std::string_view(strings + other.nameOffset, other.nameLength)) {
+                error = "duplicate entry name";
+                return false;
+            }
+        }
+        seen[slot] = static_cast<std::uint32_t>(i);
+    }
+    return true;
+}
+
+// Replaces tree with the contents of the image at path and sets entries to
+// the number of entries read. On failure tree is left alone and error says
+// why.
+bool TreeImage::load(const std::string& path, GeneralTree& tree, std::size_t& entries, std::string& error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        error = "cannot read " + path;
+        return false;
+    }
+    std::size_t length = static_cast<std::size_t>(info.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    std::shared_ptr<const TreeImage> image(new TreeImage(static_cast<const char*>(mapping), length));
+    if (!image->validate(error)) {
+        return false;
+    }
+
+    const char* data = image->data;
+    const Header& header = *reinterpret_cast<const Header*>(data);
+    const NodeRecord* nodeRecords = reinterpret_cast<const NodeRecord*>(data + header.nodesOffset);
+    const InodeRecord* inodeRecords = reinterpret_cast<const InodeRecord*>(data + header.inodesOffset);
+    const char* strings = data + header.stringsOffset;
+    const char* content = data + header.contentOffset;
+    GeneralTree loaded;
+    TreeStorage& storage = *loaded.storage;
+    std::vector<Node*> nodes(header.nodeCount, nullptr);
+    std::vector<File*> inodes(header.inodeCount, nullptr);
+    // The first entry loaded for each inode, which later ones join.
+    std::vector<Node*> firstNames(header.inodeCount, nullptr);
+    std::unordered_map<std::uint64_t, ContentBuffer> blobs;
+    for (std::uint64_t i = 0; i < header.nodeCount; ++i) {
+        const NodeRecord& record = nodeRecords[i];
+        File*& inode = inodes[record.inode];
+        if (inode == nullptr) {
+            const InodeRecord& stored = inodeRecords[record.inode];
+            File file;
+            if (stored.contentLength != 0) {
+                auto blob = blobs.find(stored.contentOffset);
+                if (blob == blobs.end()) {
+                    ContentBuffer mapped(content + stored.contentOffset, stored.contentLength, image);
+                    blob = blobs.emplace(stored.contentOffset, std::move(mapped)).first;
+                }
+                file.content = blob->second;
+            }
+            file.contentHash = stored.contentHash;
+            file.modifiedTime = stored.modifiedTime;
+            file.changeTime = stored.changeTime;
+            file.ownerId = stored.ownerId;
+            file.groupId = stored.groupId;
+            file.mode = stored.mode;
+            inode = storage.inodes.allocate(file);
+            inode->setLinkCount(static_cast<int>(stored.linkCount));
+        }
+        Node*& firstName = firstNames[record.inode];
+        Node* node = loaded.createLink(std::string(strings + record.nameOffset, record.nameLength), inode, firstName);
+        firstName = firstName == nullptr ? node : firstName;
+        node->hash = record.hash;
+        nodes[i] = node;
+        if (record.parent != noParent) {
+            Node* parent = nodes[record.parent];
+            node->parent = parent;
+            parent->addChild(node);
+            ++node->refCount;
+        }
+    }
+    // Children come after their parents, so one backward pass sums the
+    // subtree totals, which the image does not store.
+    for (std::uint64_t i = header.nodeCount - 1; i > 0; --i) {
+        nodes[nodeRecords[i].parent]->bytes += nodes[i]->bytes;
+        nodes[nodeRecords[i].parent]->entries += nodes[i]->entries;
+    }
+    loaded.setRoot(nodes[0]);
+    tree = loaded;
+    entries = header.nodeCount;
+    return true;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_IMAGE_H
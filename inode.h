@@ -0,0 +1,74 @@
+#ifndef LINUX_EMULATOR_INODE_H
+#define LINUX_EMULATOR_INODE_H
+
+#include "file.h"
+#include "slab.h"
+
+#include <cstddef>
+
+namespace LinuxEmulator {
+
+// Owner of the inode records (File objects) that directory entries point at.
+// Each entry referring to an inode, in the live tree or in any snapshot of
+// it, holds one reference; the record and its content are freed when the
+// last reference is dropped. Records live in the slab allocator shared with
+// the tree's nodes, and their contents are interned in the tree's BlobStore.
+class InodeTable {
+public:
+    InodeTable(SlabAllocator&, BlobStore&);
+    File* allocate(const File&);
+    File* clone(const File*);
+    void retain(File*);
+    bool release(File*);
+    std::size_t size() const;
+private:
+    SlabAllocator& allocator;
+    BlobStore& blobs;
+    unsigned long nextInodeNumber;
+    std::size_t liveInodes;
+};
+
+InodeTable::InodeTable(SlabAllocator& a, BlobStore& b) : allocator{a}, blobs{b}, nextInodeNumber{1}, liveInodes{0} {}
+
+File* InodeTable::allocate(const File& data) {
+    File* inode = new (allocator.allocate(sizeof(File))) File(data);
+    inode->setInodeNumber(nextInodeNumber++);
+    inode->setLinkCount(0);
+    inode->setReferenceCount(0);
+    inode->internContent(blobs);
+    ++liveInodes;
+    return inode;
+}
+
+// Private copy of a record that is shared with a snapshot. The copy keeps the
+// inode number and link count: it is the same file, just a newer version.
+// The content is shared until one side writes to it.
+File* InodeTable::clone(const File* inode) {
+    File* copy = new (allocator.allocate(sizeof(File))) File(*inode);
+    copy->setReferenceCount(0);
+    ++liveInodes;
+    return copy;
+}
+
+void InodeTable::retain(File* inode) {
+    inode->setReferenceCount(inode->getReferenceCount() + 1);
+}
+
+bool InodeTable::release(File* inode) {
+    inode->setReferenceCount(inode->getReferenceCount() - 1);
+    if (inode->getReferenceCount() > 0) {
+        return false;
+    }
+    inode->~File();
+    allocator.deallocate(inode, sizeof(File));
+    --liveInodes;
+    return true;
+}
+
+std::size_t InodeTable::size() const {
+    return liveInodes;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_INODE_H
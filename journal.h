@@ -0,0 +1,497 @@
+#ifndef LINUX_EMULATOR_JOURNAL_H
+#define LINUX_EMULATOR_JOURNAL_H
+
+#include "hash.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// One state-changing operation: the command line and the working directory
+// it ran in, or (type 'W') the full text an editor session wrote to a file.
+struct JournalRecord {
+    std::uint64_t sequence;
+    char type;
+    std::string directory;
+    std::string text;
+    std::string content;
+};
+
+// Append-only write-ahead journal kept in a host directory next to its
+// checkpoints. append() only encodes the record into a pending buffer; a
+// flusher thread writes everything pending with one write() call (group
+// commit) and, depending on the sync policy, follows it with fdatasync():
+//   Always   - append() waits until its group is on disk;
+//   Interval - groups are written and synced every interval milliseconds;
+//   Never    - groups are written every interval and left to the OS.
+// A group that fails to write or sync stays pending and is written again at
+// the same offset, so the file never has a torn record in the middle; the
+// failure is kept for getError() until a group succeeds.
+// Each record on disk is [length][checksum][payload]; a torn or corrupt tail
+// left by a crash ends replay and is cut off when the journal is reopened.
+// A checkpoint is an image of the whole state named after the sequence
+// number it covers, so recovery loads the newest one and replays only the
+// records after it.
+class Journal {
+public:
+    enum class SyncPolicy { Always, Interval, Never };
+    Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal();
+    bool open(const std::string&, std::string&);
+    void close();
+    bool isOpen() const;
+    std::uint64_t append(char, const std::string&, const std::string&, const std::string& = "");
+    bool flush(std::string&);
+    void setSyncPolicy(SyncPolicy, unsigned);
+    SyncPolicy getSyncPolicy() const;
+    unsigned getInterval() const;
+    std::vector<JournalRecord> readRecords(std::uint64_t) const;
+    bool latestCheckpoint(std::uint64_t&) const;
+    std::string checkpointPath(std::uint64_t) const;
+    bool finishCheckpoint(std::uint64_t, std::string&);
+    static bool replaceFile(const std::string&, const std::string&);
+    const std::string& getDirectory() const;
+    std::uint64_t getSequence() const;
+    std::uint64_t getRecordsSinceCheckpoint() const;
+    unsigned long long getGroups() const;
+    unsigned long long getSyncs() const;
+    unsigned long long getBytesWritten() const;
+    std::string getError() const;
+    off_t getDroppedBytes() const;
+private:
+    static void putField(std::string&, const void*, std::size_t);
+    static bool syncPath(const std::string&);
+    static std::uint32_t checksum(const char*, std::size_t);
+    void run();
+    void writePending(std::unique_lock<std::mutex>&);
+    bool waitFor(std::unique_lock<std::mutex>&, std::uint64_t);
+    std::string directory;
+    int fd;
+    off_t fileSize;
+    off_t droppedBytes;
+    std::thread flusher;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable durable;
+    std::string pending;
+    bool stopping;
+    bool writing;
+    bool flushRequested;
+    SyncPolicy policy;
+    unsigned interval;
+    std::uint64_t sequence;
+    std::uint64_t writtenSequence;
+    std::uint64_t checkpointSequence;
+    std::string failure;
+    unsigned long long attempts;
+    unsigned long long groups;
+    unsigned long long syncs;
+    unsigned long long bytesWritten;
+};
+
+Journal::Journal()
+    : fd{-1}, fileSize{0}, droppedBytes{0}, stopping{false}, writing{false}, flushRequested{false},
+      policy{SyncPolicy::Interval}, interval{100}, sequence{0}, writtenSequence{0}, checkpointSequence{0},
+      attempts{0}, groups{0}, syncs{0}, bytesWritten{0} {}
+
+Journal::~Journal() {
+    close();
+}
+
+std::uint32_t Journal::checksum(const char* bytes, std::size_t length) {
+    return static_cast<std::uint32_t>(mixHash(hashBytes(bytes, length)));
+}
+
+void Journal::putField(std::string& out, const void* bytes, std::size_t length) {
+    out.append(static_cast<const char*>(bytes), length);
+}
+
+// Opens the journal in directory (which must exist), dropping any torn tail,
+// and starts the flusher. Sequence numbers continue after the last record
+// or checkpoint found there.
+bool Journal::open(const std::string& dir, std::string& error) {
+    close();
+    directory = dir;
+    checkpointSequence = 0;
+    latestCheckpoint(checkpointSequence);
+    std::vector<JournalRecord> records = readRecords(0);
+    sequence = records.empty() ? 0 : records.back().sequence;
+    if (sequence < checkpointSequence) {
+        sequence = checkpointSequence;
+    }
+    writtenSequence = sequence;
+    failure.clear();
+    // Groups are written with pwrite() at fileSize rather than appended, so
+    // a failed group can be written again over its own partial bytes.
+    fd = ::open((directory + "/journal").c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        error = "cannot open " + directory + "/journal";
+        return false;
+    }
+    // readRecords() stopped at the end of the last intact record.
+    off_t validEnd = 0;
+    for (const JournalRecord& record : records) {
+        validEnd += static_cast<off_t>(8 + 8 + 1 + 12 + record.directory.size() + record.text.size() +
+                                       record.content.size());
+    }
+    struct stat status;
+    droppedBytes = fstat(fd, &status) == 0 && status.st_size > validEnd ? status.st_size - validEnd : 0;
+    if (ftruncate(fd, validEnd) != 0) {
+        error = "cannot truncate " + directory + "/journal";
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    fileSize = validEnd;
+    stopping = false;
+    flusher = std::thread(&Journal::run, this);
+    return true;
+}
+
+// Writes out what is pending, syncs it and stops the flusher; getError()
+// tells whether that worked.
+void Journal::close() {
+    if (fd < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    if (fdatasync(fd) != 0 && failure.empty()) {
+        failure = std::string("fdatasync failed: ") + std::strerror(errno);
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+bool Journal::isOpen() const {
+    return fd >= 0;
+}
+
+// Returns the record's sequence number. Under the Always policy it returns
+// once the record is durable or its group has failed (see getError()).
+std::uint64_t Journal::append(char type, const std::string& dir, const std::string& text, const std::string& content) {
+    if (fd < 0) {
+        return 0;
+    }
+    std::string payload;
+    std::uint32_t lengths[3] = {static_cast<std::uint32_t>(dir.size()), static_cast<std::uint32_t>(text.size()),
+                                static_cast<std::uint32_t>(content.size())};
+    std::unique_lock<std::mutex> lock(mutex);
+    std::uint64_t recordSequence = ++sequence;
+    putField(payload, &recordSequence, sizeof(recordSequence));
+    payload.push_back(type);
+    putField(payload, lengths, sizeof(lengths));
+    payload += dir;
+    payload += text;
+    payload += content;
+    std::uint32_t header[2] = {static_cast<std::uint32_t>(payload.size()), checksum(payload.data(), payload.size())};
+    putField(pending, header, sizeof(header));
+    pending += payload;
+    wake.notify_one();
+    if (policy == SyncPolicy::Always) {
+        waitFor(lock, recordSequence);
+    }
+    return recordSequence;
+}
+
+// Waits until the records up to target are written or an attempt made after
+// the call has failed; returns whether they were written.
+bool Journal::waitFor(std::unique_lock<std::mutex>& lock, std::uint64_t target) {
+    unsigned long long attempt = attempts;
+    durable.wait(lock, [&] {
+        return (writtenSequence >= target && !writing) || fd < 0 || (attempts != attempt && !failure.empty());
+    });
+    return writtenSequence >= target;
+}
+
+// Blocks until every record appended so far is written and synced.
+bool Journal::flush(std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushRequested = true;
+    wake.notify_one();
+    if (!waitFor(lock, sequence)) {
+        error = failure.empty() ? "journal is closed" : failure;
+        return false;
+    }
+    lock.unlock();
+    if (fdatasync(fd) != 0) {
+        error = std::string("fdatasync failed: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Called with the lock held; drops it around the I/O so appends can go on
+// filling the next group.
+void Journal::writePending(std::unique_lock<std::mutex>& lock) {
+    if (pending.empty()) {
+        return;
+    }
+    std::string group;
+    group.swap(pending);
+    std::uint64_t groupSequence = sequence;
+    bool sync = policy != SyncPolicy::Never;
+    off_t offset = fileSize;
+    writing = true;
+    lock.unlock();
+    std::string error;
+    std::size_t done = 0;
+    while (done < group.size() && error.empty()) {
+        ssize_t count = ::pwrite(fd, group.data() + done, group.size() - done, offset + static_cast<off_t>(done));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            error = count == 0 ? std::string("write made no progress") : std::string("write failed: ") + std::strerror(errno);
+        } else {
+            done += static_cast<std::size_t>(count);
+        }
+    }
+    if (error.empty() && sync && fdatasync(fd) != 0) {
+        error = std::string("fdatasync failed: ") + std::strerror(errno);
+    }
+    lock.lock();
+    writing = false;
+    ++attempts;
+    if (error.empty()) {
+        fileSize += static_cast<off_t>(done);
+        writtenSequence = groupSequence;
+        failure.clear();
+        ++groups;
+        syncs += sync ? 1 : 0;
+        bytesWritten += done;
+    } else {
+        // Records appended meanwhile follow the group in the next attempt.
+        pending.insert(0, group);
+        failure = error;
+    }
+    durable.notify_all();
+}
+
+// Sleeps until there is something to write; unless a writer is waiting, the
+// first record of a group then gets interval milliseconds of company. After
+// a failure every policy waits that long before trying again.
+void Journal::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait(lock, [&] { return stopping || flushRequested || !pending.empty(); });
+        if ((policy != SyncPolicy::Always || !failure.empty()) && !flushRequested) {
+            wake.wait_for(lock, std::chrono::milliseconds(interval), [&] {
+                return stopping || flushRequested || (policy == SyncPolicy::Always && failure.empty());
+            });
+        }
+        flushRequested = false;
+        writePending(lock);
+        durable.notify_all();
+    }
+    writePending(lock);
+}
+
+void Journal::setSyncPolicy(SyncPolicy p, unsigned milliseconds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        policy = p;
+        interval = milliseconds == 0 ? 1 : milliseconds;
+    }
+    wake.notify_one();
+}
+
+Journal::SyncPolicy Journal::getSyncPolicy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return policy;
+}
+
+unsigned Journal::getInterval() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return interval;
+}
+
+// Reads the intact records with a sequence number above after, in order.
+std::vector<JournalRecord> Journal::readRecords(std::uint64_t after) const {
+    std::vector<JournalRecord> records;
+    std::FILE* in = std::fopen((directory + "/journal").c_str(), "rb");
+    if (in == nullptr) {
+        return records;
+    }
+    std::uint32_t header[2];
+    std::string payload;
+    while (std::fread(header, sizeof(header), 1, in) == 1) {
+        const std::size_t fixed = sizeof(std::uint64_t) + 1 + 3 * sizeof(std::uint32_t);
+        if (header[0] < fixed) {
+            break;
+        }
+        payload.resize(header[0]);
+        if (std::fread(&payload[0], 1, payload.size(), in) != payload.size() ||
+            checksum(payload.data(), payload.size()) != header[1]) {
+            break;
+        }
+        JournalRecord record;
+        std::uint32_t lengths[3];
+        std::memcpy(&record.sequence, payload.data(), sizeof(record.sequence));
+        record.type = payload[sizeof(record.sequence)];
+        std::memcpy(lengths, payload.data() + sizeof(record.sequence) + 1, sizeof(lengths));
+        if (static_cast<std::uint64_t>(lengths[0]) + lengths[1] + lengths[2] != payload.size() - fixed) {
+            break;
+        }
+        record.directory = payload.substr(fixed, lengths[0]);
+        record.text = payload.substr(fixed + lengths[0], lengths[1]);
+        record.content = payload.substr(fixed + lengths[0] + lengths[1], lengths[2]);
+        records.push_back(std::move(record));
+    }
+    std::fclose(in);
+    // Records up to a checkpoint are kept until the journal is cut; the
+    // caller only wants the ones after it.
+    if (after != 0) {
+        std::vector<JournalRecord> tail;
+        for (JournalRecord& record : records) {
+            if (record.sequence > after) {
+                tail.push_back(std::move(record));
+            }
+        }
+        return tail;
+    }
+    return records;
+}
+
+// Finds the sequence number of the newest complete checkpoint, if any.
+bool Journal::latestCheckpoint(std::uint64_t& latest) const {
+    bool found = false;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    while (dirent* entry = readdir(dir)) {
+        unsigned long long checkpoint = 0;
+        char suffix[8] = {};
+        if (std::sscanf(entry->d_name, "checkpoint-%llu.%7s", &checkpoint, suffix) == 2 &&
+            std::strcmp(suffix, "img") == 0 && (!found || checkpoint > latest)) {
+            latest = checkpoint;
+            found = true;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+// Checkpoint files share this prefix; the ".img" file is renamed into place
+// last and marks the checkpoint complete.
+std::string Journal::checkpointPath(std::uint64_t checkpoint) const {
+    return directory + "/checkpoint-" + std::to_string(checkpoint);
+}
+
+// Once the checkpoint for sequence number checkpoint is durable, the journal
+// can start over and older checkpoints can go.
+bool Journal::finishCheckpoint(std::uint64_t checkpoint, std::string& error) {
+    if (!flush(error)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (checkpoint == sequence && !writing && pending.empty()) {
+        if (ftruncate(fd, 0) != 0 || fdatasync(fd) != 0) {
+            error = "cannot truncate " + directory + "/journal";
+            return false;
+        }
+        fileSize = 0;
+    }
+    checkpointSequence = checkpoint;
+    DIR* dir = opendir(directory.c_str());
+    if (dir != nullptr) {
+        std::vector<std::string> stale;
+        while (dirent* entry = readdir(dir)) {
+            unsigned long long older = 0;
+            if (std::sscanf(entry->d_name, "checkpoint-%llu.", &older) == 1 && older < checkpoint) {
+                stale.push_back(directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+        for (const std::string& path : stale) {
+            std::remove(path.c_str());
+        }
+    }
+    return true;
+}
+
+bool Journal::syncPath(const std::string& path) {
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    bool synced = fsync(file) == 0;
+    ::close(file);
+    return synced;
+}
+
+// Makes temporary durable and atomically moves it to destination.
+bool Journal::replaceFile(const std::string& temporary, const std::string& destination) {
+    if (!syncPath(temporary) || std::rename(temporary.c_str(), destination.c_str()) != 0) {
+        return false;
+    }
+    std::size_t slash = destination.find_last_of('/');
+    syncPath(slash == std::string::npos ? "." : destination.substr(0, slash + 1));
+    return true;
+}
+
+const std::string& Journal::getDirectory() const {
+    return directory;
+}
+
+std::uint64_t Journal::getSequence() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sequence;
+}
+
+std::uint64_t Journal::getRecordsSinceCheckpoint() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sequence - checkpointSequence;
+}
+
+unsigned long long Journal::getGroups() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return groups;
+}
+
+unsigned long long Journal::getSyncs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return syncs;
+}
+
+unsigned long long Journal::getBytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten;
+}
+
+// The reason the last group failed, or empty once one has succeeded.
+std::string Journal::getError() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failure;
+}
+
+// Bytes of torn or corrupt tail cut off when the journal was opened.
+off_t Journal::getDroppedBytes() const {
+    return droppedBytes;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_JOURNAL_H
@@ -0,0 +1,133 @@
+#ifndef LINUX_EMULATOR_LZ_H
+#define LINUX_EMULATOR_LZ_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Small LZ77 codec in the style of LZ4, used to keep cold file contents
+// compressed. A stream is a list of sequences: a token byte holding the
+// literal count (high nibble) and the match length minus minMatch (low
+// nibble), each extended by 255-continuation bytes when the nibble is 15,
+// then the literals, then a 16-bit little-endian match offset. The last
+// sequence has literals only. Matches are found through a hash table of
+// 4-byte prefixes, so compression is one greedy pass.
+namespace lz {
+
+const std::size_t minMatch = 4;
+const std::size_t maxOffset = 65535;
+const unsigned hashBits = 12;
+
+inline std::uint32_t read32(const char* p) {
+    std::uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline std::uint32_t hashPrefix(const char* p) {
+    return (read32(p) * 2654435761U) >> (32 - hashBits);
+}
+
+inline void writeLength(std::vector<char>& out, std::size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+// Appends the compressed form of [in, in + size) to out.
+inline void compress(const char* in, std::size_t size, std::vector<char>& out) {
+    std::vector<std::uint32_t> table(static_cast<std::size_t>(1) << hashBits, 0);
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    while (size >= minMatch && position + minMatch <= size) {
+        std::uint32_t slot = hashPrefix(in + position);
+        std::size_t candidate = table[slot];
+        table[slot] = static_cast<std::uint32_t>(position);
+        if (candidate >= position || position - candidate > maxOffset ||
+            read32(in + candidate) != read32(in + position)) {
+            ++position;
+            continue;
+        }
+        std::size_t match = minMatch;
+        while (position + match < size && in[candidate + match] == in[position + match]) {
+            ++match;
+        }
+        std::size_t literals = position - anchor;
+        std::size_t extra = match - minMatch;
+        out.push_back(static_cast<char>(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15)));
+        if (literals >= 15) {
+            writeLength(out, literals - 15);
+        }
+        out.insert(out.end(), in + anchor, in + position);
+        std::size_t offset = position - candidate;
+        out.push_back(static_cast<char>(offset & 0xff));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (extra >= 15) {
+            writeLength(out, extra - 15);
+        }
+        position += match;
+        anchor = position;
+    }
+    std::size_t literals = size - anchor;
+    out.push_back(static_cast<char>((literals < 15 ? literals : 15) << 4));
+    if (literals >= 15) {
+        writeLength(out, literals - 15);
+    }
+    out.insert(out.end(), in + anchor, in + size);
+}
+
+// Decodes [in, in + size) into exactly outSize bytes at out. Returns false
+// if the stream is malformed.
+inline bool decompress(const char* in, std::size_t size, char* out, std::size_t outSize) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    const unsigned char* end = p + size;
+    std::size_t written = 0;
+    auto readLength = [&](std::size_t length) {
+        if (length != 15) {
+            return length;
+        }
+        unsigned char next = 255;
+        while (next == 255 && p < end) {
+            next = *p++;
+            length += next;
+        }
+        return length;
+    };
+    while (p < end) {
+        unsigned char token = *p++;
+        std::size_t literals = readLength(token >> 4);
+        if (literals > static_cast<std::size_t>(end - p) || literals > outSize - written) {
+            return false;
+        }
+        std::memcpy(out + written, p, literals);
+        p += literals;
+        written += literals;
+        if (p == end) {
+            break;
+        }
+        if (end - p < 2) {
+            return false;
+        }
+        std::size_t offset = p[0] | (static_cast<std::size_t>(p[1]) << 8);
+        p += 2;
+        std::size_t match = readLength(token & 15) + minMatch;
+        if (offset == 0 || offset > written || match > outSize - written) {
+            return false;
+        }
+        // Byte by byte: the source may overlap the bytes being written.
+        for (std::size_t i = 0; i < match; ++i, ++written) {
+            out[written] = out[written - offset];
+        }
+    }
+    return written == outSize;
+}
+
+} // namespace lz
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_LZ_H
@@ -1,9 +1,10 @@
-#include <iostream>
-#include "display.h"
-
-int main() {
-    LinuxEmulator::Display display;
-    display.run();
-
-    return 0;
+#include <iostream>
+#include "display.h"
+
+int main(int argc, char* argv[]) {
+    // An optional argument names a file system image to start from.
+    LinuxEmulator::Display display(argc > 1 ? argv[1] : "");
+    display.run();
+
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef LINUX_EMULATOR_PATHCACHE_H
+#define LINUX_EMULATOR_PATHCACHE_H
+
+#include "gtree.h"
+
+#include <string>
+#include <map>
+#include <list>
+#include <cstddef>
+
+namespace LinuxEmulator {
+
+// Bounded LRU cache of normalized path -> Node. A cached nullptr is a
+// negative entry: the path was looked up recently and does not exist.
+// Entries are kept in an ordered map so that a whole subtree of paths can be
+// dropped with one range erase when a directory is moved or deleted.
+class PathCache {
+public:
+    PathCache(std::size_t = 8192);
+    PathCache(const PathCache&);
+    PathCache& operator=(const PathCache&);
+    bool lookup(const std::string&, Node*&);
+    void insert(const std::string&, Node*);
+    void invalidate(const std::string&);
+    void invalidateSubtree(const std::string&);
+    void clear();
+    std::size_t size() const;
+    std::size_t getCapacity() const;
+    unsigned long long getHits() const;
+    unsigned long long getNegativeHits() const;
+    unsigned long long getMisses() const;
+private:
+    struct Entry {
+        Node* node;
+        std::list<const std::string*>::iterator lruPosition;
+    };
+    void erase(std::map<std::string, Entry>::iterator);
+    std::map<std::string, Entry> entries;
+    std::list<const std::string*> lru;
+    std::size_t capacity;
+    unsigned long long hits;
+    unsigned long long negativeHits;
+    unsigned long long misses;
+};
+
+PathCache::PathCache(std::size_t c) : capacity{c}, hits{0}, negativeHits{0}, misses{0} {}
+
+// The cache only holds derived state, and its LRU list points into its own
+// map, so copies start out empty instead of sharing entries.
+PathCache::PathCache(const PathCache& other) : capacity{other.capacity}, hits{0}, negativeHits{0}, misses{0} {}
+
+PathCache& PathCache::operator=(const PathCache& other) {
+    if (this != &other) {
+        clear();
+        capacity = other.capacity;
+    }
+    return *this;
+}
+
+bool PathCache::lookup(const std::string& path, Node*& node) {
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        ++misses;
+        return false;
+    }
+    lru.splice(lru.begin(), lru, it->second.lruPosition);
+    node = it->second.node;
+    if (node == nullptr) {
+        ++negativeHits;
+    } else {
+        ++hits;
+    }
+    return true;
+}
+
+void PathCache::insert(const std::string& path, Node* node) {
+    if (capacity == 0) {
+        return;
+    }
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        it->second.node = node;
+        lru.splice(lru.begin(), lru, it->second.lruPosition);
+        return;
+    }
+    if (entries.size() >= capacity) {
+        erase(entries.find(*lru.back()));
+    }
+    it = entries.emplace(path, Entry{node, lru.end()}).first;
+    lru.push_front(&it->first);
+    it->second.lruPosition = lru.begin();
+}
+
+void PathCache::erase(std::map<std::string, Entry>::iterator it) {
+    lru.erase(it->second.lruPosition);
+    entries.erase(it);
+}
+
+void PathCache::invalidate(const std::string& path) {
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        erase(it);
+    }
+}
+
+void PathCache::invalidateSubtree(const std::string& path) {
+    if (path == "/") {
+        clear();
+        return;
+    }
+    invalidate(path);
+    // Every descendant key sorts in [path + "/", path + "0") since '0' follows '/'.
+    auto it = entries.lower_bound(path + "/");
+    auto end = entries.lower_bound(path + "0");
+    while (it != end) {
+        erase(it++);
+    }
+}
+
+void PathCache::clear() {
+    entries.clear();
+    lru.clear();
+}
+
+std::size_t PathCache::size() const {
+    return entries.size();
+}
+
+std::size_t PathCache::getCapacity() const {
+    return capacity;
+}
+
+unsigned long long PathCache::getHits() const {
+    return hits;
+}
+
+unsigned long long PathCache::getNegativeHits() const {
+    return negativeHits;
+}
+
+unsigned long long PathCache::getMisses() const {
+    return misses;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_PATHCACHE_H
@@ -0,0 +1,266 @@
+#ifndef LINUX_EMULATOR_RECLAIM_H
+#define LINUX_EMULATOR_RECLAIM_H
+
+#include "gtree.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Exclusive use of a tree's storage by the foreground. The reclaimer runs
+// no batch on a storage while a lock on it exists, and holds back while one
+// is being requested, so a command waits for one batch at most. The mutex
+// is recursive because a command may run others (journal replay) and the
+// exam compares two file systems that can share a storage.
+class StorageLock {
+public:
+    StorageLock() = default;
+    explicit StorageLock(std::shared_ptr<TreeStorage>);
+    StorageLock(StorageLock&&) = default;
+    StorageLock& operator=(StorageLock&&) = default;
+private:
+    std::shared_ptr<TreeStorage> storage;
+    std::unique_lock<std::recursive_mutex> lock;
+};
+
+// Frees detached subtrees on a background thread. A subtree is handed over
+// with one reference on its top node and freed in batches of at most
+// batchNodes nodes or batchTime, each under the storage lock; after every
+// batch the thread sleeps as long as the batch took, so it never takes more
+// than half a core or holds up a command for more than one batch.
+//
+// Every name in the subtree is visited, also below nodes still shared with
+// a snapshot: those keep their nodes, but the names are gone from the live
+// tree all the same. Entries of inodes that had more than one link are kept,
+// with the reference the thread held on them, and listed; before its next
+// command the owner takes them with takeUnlinked(), lowers the link counts
+// through the inodes' rings of entries, since only it can make them
+// writable, and releases them.
+class Reclaimer {
+public:
+    struct Stats {
+        std::uint64_t pendingEntries;
+        std::uint64_t pendingBytes;
+        std::uint64_t reclaimedEntries;
+        std::uint64_t reclaimedBytes;
+        std::uint64_t batches;
+    };
+    struct Unlinked {
+        std::shared_ptr<TreeStorage> storage;
+        Node* node;
+    };
+    Reclaimer();
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+    ~Reclaimer();
+    void add(std::shared_ptr<TreeStorage>, Node*);
+    void drain();
+    Stats getStats() const;
+    std::vector<Unlinked> takeUnlinked();
+private:
+    static const std::size_t batchNodes = 4096;
+    static constexpr std::chrono::microseconds batchTime{500};
+    struct Work {
+        std::shared_ptr<TreeStorage> storage;
+        std::vector<Node*> pending;
+    };
+    bool step(Work&, bool);
+    void run();
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Work> work;
+    std::vector<Unlinked> unlinked;
+    std::atomic<bool> stopping;
+    std::atomic<std::uint64_t> pendingEntries;
+    std::atomic<std::uint64_t> pendingBytes;
+    std::atomic<std::uint64_t> reclaimedEntries;
+    std::atomic<std::uint64_t> reclaimedBytes;
+    std::atomic<std::uint64_t> batches;
+    std::thread worker;
+};
+
+StorageLock::StorageLock(std::shared_ptr<TreeStorage> s) : storage{std::move(s)} {
+    ++storage->lockWaiters;
+    lock = std::unique_lock<std::recursive_mutex>(storage->lock);
+    --storage->lockWaiters;
+}
+
+Reclaimer::Reclaimer() : stopping{false}, pendingEntries{0}, pendingBytes{0}, reclaimedEntries{0}, reclaimedBytes{0},
+    batches{0}, worker{&Reclaimer::run, this} {}
+
+// Whatever is left is freed before the thread goes.
+Reclaimer::~Reclaimer() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+    drain();
+    for (Unlinked& entry : unlinked) {
+        GeneralTree::release(*entry.storage, entry.node);
+    }
+}
+
+// Takes over node, already detached from its parent, together with the
+// reference the parent held on it. The caller holds the storage lock.
+void Reclaimer::add(std::shared_ptr<TreeStorage> storage, Node* node) {
+    pendingEntries += node->entries;
+    pendingBytes += node->bytes;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        work.push_back({std::move(storage), {node}});
+    }
+    wake.notify_one();
+}
+
+// Visits the names of a subtree, a batch of them when throttled, and returns
+// whether it is done. Each node on the pending stack carries one reference.
+// Dropping the last one frees the node and hands its references on its
+// children to the stack; a node that stays alive lends its children one
+// reference each, so that nothing on the stack can be freed under it.
+bool Reclaimer::step(Work& item, bool throttled) {
+    TreeStorage& store = *item.storage;
+    SlabAllocator::Batch freedNodes;
+    auto start = std::chrono::steady_clock::now();
+    std::size_t visited = 0;
+    std::uint64_t bytes = 0;
+    while (!item.pending.empty() && (!throttled || visited < batchNodes)) {
+        if (throttled && visited % 64 == 63 && std::chrono::steady_clock::now() - start > batchTime) {
+            break;
+        }
+        Node* curr = item.pending.back();
+        item.pending.pop_back();
+        ++visited;
+        if (!curr->data->getIsDirectory()) {
+            // The size the totals were made of, even if the inode has been
+            // written through another name since.
+            bytes += curr->bytes;
+            if (curr->data->getLinkCount() > 1) {
+                // The list takes over the reference; a file has no children.
+                std::lock_guard<std::mutex> guard(mutex);
+                unlinked.push_back({item.storage, curr});
+                continue;
+            }
+        }
+        if (--curr->refCount != 0) {
+            for (Node* child : curr->children) {
+                ++child->refCount;
+                item.pending.push_back(child);
+            }
+            continue;
+        }
+        for (Node* child : curr->children) {
+            if (child->parent == curr) {
+                child->parent = nullptr;
+            }
+        }
+        item.pending.insert(item.pending.end(), curr->children.begin(), curr->children.end());
+        curr->leaveLinks();
+        store.inodes.release(curr->data);
+        store.names.release(curr->name);
+        curr->~Node();
+        --store.nodeCount;
+        store.allocator.addToBatch(freedNodes, curr);
+    }
+    store.allocator.deallocateBatch(freedNodes, sizeof(Node));
+    pendingEntries -= visited;
+    pendingBytes -= bytes;
+    reclaimedEntries += visited;
+    reclaimedBytes += bytes;
+    ++batches;
+    return item.pending.empty();
+}
+
+void Reclaimer::run() {
+    std::unique_lock<std::mutex> guard(mutex);
+    while (true) {
+        wake.wait(guard, [this]() { return stopping || !work.empty(); });
+        if (stopping) {
+            return;
+        }
+        std::shared_ptr<TreeStorage> storage = work.front().storage;
+        guard.unlock();
+        // Storage lock before the queue lock, in this order everywhere. The
+        // lock is polled so that the owner can stop the thread while it
+        // holds the storage itself.
+        std::unique_lock<std::recursive_mutex> storageGuard(storage->lock, std::defer_lock);
+        while (!stopping && (storage->lockWaiters.load() != 0 || !storageGuard.try_lock())) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (!storageGuard.owns_lock()) {
+            return;
+        }
+        guard.lock();
+        auto start = std::chrono::steady_clock::now();
+        if (!work.empty() && work.front().storage == storage) {
+            Work item = std::move(work.front());
+            work.pop_front();
+            guard.unlock();
+            bool done = step(item, true);
+            guard.lock();
+            if (!done) {
+                work.push_front(std::move(item));
+            }
+        }
+        storageGuard.unlock();
+        guard.unlock();
+        std::this_thread::sleep_for(std::chrono::steady_clock::now() - start);
+        guard.lock();
+    }
+}
+
+// Frees everything queued on the calling thread, storage by storage. Used
+// when deferred reclaiming is switched off and on destruction.
+void Reclaimer::drain() {
+    while (true) {
+        std::shared_ptr<TreeStorage> storage;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (work.empty()) {
+                return;
+            }
+            storage = work.front().storage;
+        }
+        std::lock_guard<std::recursive_mutex> storageGuard(storage->lock);
+        std::deque<Work> items;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            for (auto it = work.begin(); it != work.end();) {
+                if (it->storage == storage) {
+                    items.push_back(std::move(*it));
+                    it = work.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        for (Work& item : items) {
+            step(item, false);
+        }
+    }
+}
+
+Reclaimer::Stats Reclaimer::getStats() const {
+    return {pendingEntries.load(), pendingBytes.load(), reclaimedEntries.load(), reclaimedBytes.load(), batches.load()};
+}
+
+std::vector<Reclaimer::Unlinked> Reclaimer::takeUnlinked() {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::vector<Unlinked> taken;
+    taken.swap(unlinked);
+    return taken;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_RECLAIM_H
@@ -0,0 +1,616 @@
+#ifndef LINUX_EMULATOR_REGEX_H
+#define LINUX_EMULATOR_REGEX_H
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// POSIX-style regular expression compiled to a Thompson NFA, in grep's basic
+// syntax (where \( \) \| \+ \? \{ \} are the operators) or in its extended
+// syntax (where they are written bare). Supported are literals, ".", bracket
+// expressions with ranges, negation and [:class:] names, \w \W \s \S \d \D,
+// "^", "$", grouping, alternation and the * + ? {m} {m,} {m,n} repetitions.
+// Back-references are not. "^" and "$" are zero-width assertions that hold
+// at the start and at the end of a line.
+class RegexProgram {
+public:
+    static const int symbols = 256;
+    // A Set state reads one byte of set and goes to out; a Split state goes
+    // to out and out1 without reading, and LineBegin and LineEnd go to out
+    // where their assertion holds; Match accepts.
+    struct State {
+        enum Kind { Set, Split, LineBegin, LineEnd, Match } kind;
+        int out;
+        int out1;
+        int set;
+    };
+    typedef std::bitset<symbols> SymbolSet;
+    bool compile(const std::string&, bool, bool, std::string&);
+    const std::vector<State>& getStates() const;
+    const SymbolSet& getSet(int) const;
+    int getStart() const;
+private:
+    static const int maxRepeat = 255;
+    static const std::size_t maxStates = 100000;
+    // Parse tree; a Repeat with max -1 has no upper bound.
+    struct Ast {
+        enum Kind { Symbols, Concat, Alternate, Repeat, Anchor, Empty } kind;
+        int set;
+        int min;
+        int max;
+        std::vector<std::unique_ptr<Ast>> children;
+    };
+    typedef std::unique_ptr<Ast> AstPtr;
+    // Dangling exits of a fragment, as (state, second exit) pairs.
+    struct Fragment {
+        int start;
+        std::vector<std::pair<int, bool>> exits;
+    };
+    AstPtr parseAlternation();
+    AstPtr parseConcatenation();
+    AstPtr parseRepetition();
+    AstPtr parseAtom();
+    AstPtr parseBracket();
+    bool atOperator(char) const;
+    bool parseCount(int&);
+    AstPtr makeSet(const SymbolSet&);
+    static AstPtr makeNode(Ast::Kind);
+    static void addClass(SymbolSet&, const std::string&);
+    SymbolSet foldCase(const SymbolSet&) const;
+    int addState(State::Kind, int, int, int);
+    void patch(const Fragment&, int);
+    Fragment emit(const Ast&);
+    Fragment emitRepeat(const Ast&);
+    std::string pattern;
+    std::size_t position = 0;
+    bool extended = false;
+    bool ignoreCase = false;
+    std::string error;
+    std::vector<State> states;
+    std::vector<SymbolSet> sets;
+    int start = -1;
+};
+
+// Lazily built DFA over a RegexProgram that finds the lines of a text with
+// a match anywhere in them. A DFA state is a set of NFA states; transitions
+// are computed on first use and cached in a flat table, so after warming up
+// each byte costs one table lookup. The start states are added back after
+// every byte, which makes the search unanchored. The end of a line is an
+// extra column of the table, the only transition that lets "$" through,
+// and "^" is let through only in the state a line starts in. When the cache
+// grows past maxStates it is dropped and rebuilt, bounding memory for
+// patterns whose full DFA would be exponential. A LazyDfa is not
+// thread-safe; every thread builds its own over the shared program.
+class LazyDfa {
+public:
+    static const int endOfLine = RegexProgram::symbols;
+    explicit LazyDfa(const RegexProgram&);
+    int lineStart() const;
+    int next(int, int);
+    bool accepts(int) const;
+    template <typename Report>
+    void searchLines(const char*, std::size_t, Report&&);
+private:
+    static const std::size_t maxStates = 4096;
+    static const int columns = RegexProgram::symbols + 1;
+    static const int unknown = -1;
+    int addState(std::vector<int>&, bool);
+    void closure(std::vector<int>&, bool, bool) const;
+    void reset();
+    const RegexProgram& program;
+    std::map<std::pair<std::vector<int>, bool>, int> ids;
+    std::vector<std::vector<int>> sets;
+    std::vector<char> atLineStart;
+    std::vector<int> table;
+    std::vector<char> accepting;
+    std::vector<int> initial;
+    int lineStartState;
+};
+
+bool RegexProgram::compile(const std::string& source, bool extendedSyntax, bool foldCase, std::string& message) {
+    pattern = source;
+    position = 0;
+    extended = extendedSyntax;
+    ignoreCase = foldCase;
+    error.clear();
+    states.clear();
+    sets.clear();
+    AstPtr tree = parseAlternation();
+    if (error.empty() && position < pattern.size()) {
+        error = atOperator(')') ? "Unmatched ) or \\)" : "Trailing characters in pattern";
+    }
+    if (error.empty()) {
+        Fragment whole = emit(*tree);
+        int match = addState(State::Match, -1, -1, -1);
+        patch(whole, match);
+        start = whole.start;
+        if (states.size() > maxStates) {
+            error = "Regular expression too big";
+        }
+    }
+    message = error;
+    return error.empty();
+}
+
+const std::vector<RegexProgram::State>& RegexProgram::getStates() const {
+    return states;
+}
+
+const RegexProgram::SymbolSet& RegexProgram::getSet(int index) const {
+    return sets[index];
+}
+
+int RegexProgram::getStart() const {
+    return start;
+}
+
+// True if the next character is the operator c, which basic syntax writes
+// with a backslash.
+bool RegexProgram::atOperator(char c) const {
+    if (extended) {
+        return position < pattern.size() && pattern[position] == c;
+    }
+    return position + 1 < pattern.size() && pattern[position] == '\\' && pattern[position + 1] == c;
+}
+
+RegexProgram::AstPtr RegexProgram::makeNode(Ast::Kind kind) {
+    AstPtr node(new Ast());
+    node->kind = kind;
+    node->set = -1;
+    node->min = 0;
+    node->max = 0;
+    return node;
+}
+
+RegexProgram::AstPtr RegexProgram::makeSet(const SymbolSet& set) {
+    AstPtr node = makeNode(Ast::Symbols);
+    node->set = static_cast<int>(sets.size());
+    sets.push_back(ignoreCase ? foldCase(set) : set);
+    return node;
+}
+
+RegexProgram::SymbolSet RegexProgram::foldCase(const SymbolSet& set) const {
+    SymbolSet folded = set;
+    for (int c = 'A'; c <= 'Z'; ++c) {
+        if (set[c] || set[c + 'a' - 'A']) {
+            folded.set(c);
+            folded.set(c + 'a' - 'A');
+        }
+    }
+    return folded;
+}
+
+RegexProgram::AstPtr RegexProgram::parseAlternation() {
+    AstPtr left = parseConcatenation();
+    while (error.empty() && atOperator('|')) {
+        position += extended ? 1 : 2;
+        AstPtr alternate = makeNode(Ast::Alternate);
+        alternate->children.push_back(std::move(left));
+        alternate->children.push_back(parseConcatenation());
+        left = std::move(alternate);
+    }
+    return left;
+}
+
+RegexProgram::AstPtr RegexProgram::parseConcatenation() {
+    AstPtr sequence = makeNode(Ast::Concat);
+    while (error.empty() && position < pattern.size() && !atOperator('|') && !atOperator(')')) {
+        sequence->children.push_back(parseRepetition());
+    }
+    return sequence;
+}
+
+// Reads a decimal count of at most maxRepeat.
+bool RegexProgram::parseCount(int& count) {
+    if (position >= pattern.size() || !std::isdigit(static_cast<unsigned char>(pattern[position]))) {
+        return false;
+    }
+    count = 0;
+    while (position < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[position]))) {
+        count = std::min(count * 10 + (pattern[position++] - '0'), maxRepeat + 1);
+    }
+    return true;
+}
+
+RegexProgram::AstPtr RegexProgram::parseRepetition() {
+    AstPtr atom = parseAtom();
+    while (error.empty() && position < pattern.size()) {
+        int min = 0;
+        int max = -1;
+        if (pattern[position] == '*') {
+            position += 1;
+        } else if (atOperator('+') || atOperator('?')) {
+            min = atOperator('+') ? 1 : 0;
+            max = atOperator('+') ? -1 : 1;
+            position += extended ? 1 : 2;
+        } else if (atOperator('{')) {
+            position += extended ? 1 : 2;
+            bool hasMin = parseCount(min);
+            max = min;
+            if (position < pattern.size() && pattern[position] == ',') {
+                ++position;
+                max = -1;
+                parseCount(max);
+            }
+            if (!hasMin || !atOperator('}')) {
+                error = "Invalid content of \\{\\}";
+                break;
+            }
+            position += extended ? 1 : 2;
+            if (min > maxRepeat || max > maxRepeat || (max != -1 && max < min)) {
+                error = "Invalid content of \\{\\}";
+                break;
+            }
+        } else {
+            break;
+        }
+        AstPtr repeat = makeNode(Ast::Repeat);
+        repeat->min = min;
+        repeat->max = max;
+        repeat->children.push_back(std::move(atom));
+        atom = std::move(repeat);
+    }
+    return atom;
+}
+
+RegexProgram::AstPtr RegexProgram::parseAtom() {
+    SymbolSet set;
+    if (atOperator('(')) {
+        position += extended ? 1 : 2;
+        AstPtr group = parseAlternation();
+        if (error.empty() && !atOperator(')')) {
+            error = "Unmatched ( or \\(";
+        }
+        position += extended ? 1 : 2;
+        return group;
+    }
+    char c = pattern[position++];
+    if (c == '[') {
+        return parseBracket();
+    }
+    if (c == '.') {
+        set.set();
+        set.reset('\n');
+        return makeSet(set);
+    }
+    if (c == '^' || c == '$') {
+        // set is 0 for "^" and 1 for "$".
+        AstPtr anchor = makeNode(Ast::Anchor);
+        anchor->set = c == '^' ? 0 : 1;
+        return anchor;
+    }
+    if (c == '\\') {
+        if (position >= pattern.size()) {
+            error = "Trailing backslash";
+            return makeNode(Ast::Empty);
+        }
+        c = pattern[position++];
+        const std::string classes = "wWsSdD";
+        std::size_t found = classes.find(c);
+        if (found != std::string::npos) {
+            addClass(set, found < 2 ? "word" : found < 4 ? "space" : "digit");
+            if (found % 2 == 1) {
+                set.flip();
+                set.reset('\n');
+            }
+            return makeSet(set);
+        }
+    }
+    set.set(static_cast<unsigned char>(c));
+    return makeSet(set);
+}
+
+void RegexProgram::addClass(SymbolSet& set, const std::string& name) {
+    for (int c = 0; c < 256; ++c) {
+        bool member = name == "alpha" ? std::isalpha(c) : name == "digit" ? std::isdigit(c) :
+                      name == "alnum" ? std::isalnum(c) : name == "upper" ? std::isupper(c) :
+                      name == "lower" ? std::islower(c) : name == "space" ? std::isspace(c) :
+                      name == "blank" ? (c == ' ' || c == '\t') : name == "punct" ? std::ispunct(c) :
+                      name == "xdigit" ? std::isxdigit(c) : name == "cntrl" ? std::iscntrl(c) :
+                      name == "print" ? std::isprint(c) : name == "graph" ? std::isgraph(c) :
+                      name == "word" ? (std::isalnum(c) || c == '_') : false;
+        if (member && c < 128) {
+            set.set(c);
+        }
+    }
+}
+
+// Called after the opening "[".
+RegexProgram::AstPtr RegexProgram::parseBracket() {
+    SymbolSet set;
+    bool negated = position < pattern.size() && pattern[position] == '^';
+    position += negated ? 1 : 0;
+    bool first = true;
+    while (position < pattern.size() && (first || pattern[position] != ']')) {
+        first = false;
+        if (pattern.compare(position, 2, "[:") == 0) {
+            std::size_t close = pattern.find(":]", position + 2);
+            if (close == std::string::npos) {
+                break;
+            }
+            addClass(set, pattern.substr(position + 2, close - position - 2));
+            position = close + 2;
+            continue;
+        }
+        unsigned char low = static_cast<unsigned char>(pattern[position++]);
+        unsigned char high = low;
+        if (position + 1 < pattern.size() && pattern[position] == '-' && pattern[position + 1] != ']') {
+            high = static_cast<unsigned char>(pattern[position + 1]);
+            position += 2;
+            if (high < low) {
+                error = "Invalid range end";
+                return makeNode(Ast::Empty);
+            }
+        }
+        for (int c = low; c <= high; ++c) {
+            set.set(c);
+        }
+    }
+    if (position >= pattern.size()) {
+        error = "Unmatched [, [^, [:, [., or [=";
+        return makeNode(Ast::Empty);
+    }
+    ++position;
+    if (negated) {
+        set.flip();
+        set.reset('\n');
+        // Folding a negated set would add back the other case of what it excludes.
+        if (ignoreCase) {
+            for (int c = 'A'; c <= 'Z'; ++c) {
+                if (!set[c] || !set[c + 'a' - 'A']) {
+                    set.reset(c);
+                    set.reset(c + 'a' - 'A');
+                }
+            }
+        }
+        AstPtr node = makeNode(Ast::Symbols);
+        node->set = static_cast<int>(sets.size());
+        sets.push_back(set);
+        return node;
+    }
+    return makeSet(set);
+}
+
+int RegexProgram::addState(State::Kind kind, int out, int out1, int set) {
+    states.push_back(State{kind, out, out1, set});
+    return static_cast<int>(states.size()) - 1;
+}
+
+void RegexProgram::patch(const Fragment& fragment, int target) {
+    for (const auto& exit : fragment.exits) {
+        (exit.second ? states[exit.first].out1 : states[exit.first].out) = target;
+    }
+}
+
+RegexProgram::Fragment RegexProgram::emit(const Ast& node) {
+    Fragment fragment;
+    if (states.size() > maxStates) {
+        // Too big already; compile() reports it.
+        fragment.start = addState(State::Split, -1, -1, -1);
+        fragment.exits = {{fragment.start, false}, {fragment.start, true}};
+        return fragment;
+    }
+    switch (node.kind) {
+    case Ast::Symbols:
+        fragment.start = addState(State::Set, -1, -1, node.set);
+        fragment.exits.push_back({fragment.start, false});
+        return fragment;
+    case Ast::Alternate: {
+        Fragment left = emit(*node.children[0]);
+        Fragment right = emit(*node.children[1]);
+        fragment.start = addState(State::Split, left.start, right.start, -1);
+        fragment.exits = left.exits;
+        fragment.exits.insert(fragment.exits.end(), right.exits.begin(), right.exits.end());
+        return fragment;
+    }
+    case Ast::Anchor:
+        fragment.start = addState(node.set == 0 ? State::LineBegin : State::LineEnd, -1, -1, -1);
+        fragment.exits.push_back({fragment.start, false});
+        return fragment;
+    case Ast::Repeat:
+        return emitRepeat(node);
+    case Ast::Concat:
+        if (!node.children.empty()) {
+            fragment = emit(*node.children[0]);
+            for (std::size_t i = 1; i < node.children.size(); ++i) {
+                Fragment next = emit(*node.children[i]);
+                patch(fragment, next.start);
+                fragment.exits = next.exits;
+            }
+            return fragment;
+        }
+        break;
+    case Ast::Empty:
+        break;
+    }
+    // Matches the empty string: a split whose two exits both dangle.
+    fragment.start = addState(State::Split, -1, -1, -1);
+    fragment.exits = {{fragment.start, false}, {fragment.start, true}};
+    return fragment;
+}
+
+// x{m,n} is m copies of x followed by n - m optional ones, or by x* when
+// there is no upper bound.
+RegexProgram::Fragment RegexProgram::emitRepeat(const Ast& node) {
+    const Ast& body = *node.children[0];
+    Fragment chain;
+    bool empty = true;
+    auto append = [&](const Fragment& next) {
+        if (!empty) {
+            patch(chain, next.start);
+            chain.exits = next.exits;
+        } else {
+            chain = next;
+            empty = false;
+        }
+    };
+    for (int i = 0; i < node.min; ++i) {
+        append(emit(body));
+    }
+    if (node.max == -1) {
+        int loop = addState(State::Split, -1, -1, -1);
+        Fragment copy = emit(body);
+        states[loop].out = copy.start;
+        patch(copy, loop);
+        append(Fragment{loop, {{loop, true}}});
+    }
+    for (int i = node.min; i < node.max; ++i) {
+        int optional = addState(State::Split, -1, -1, -1);
+        Fragment copy = emit(body);
+        states[optional].out = copy.start;
+        copy.start = optional;
+        copy.exits.push_back({optional, true});
+        append(copy);
+    }
+    if (empty) {
+        chain.start = addState(State::Split, -1, -1, -1);
+        chain.exits = {{chain.start, false}, {chain.start, true}};
+    }
+    return chain;
+}
+
+LazyDfa::LazyDfa(const RegexProgram& regex) : program{regex} {
+    reset();
+}
+
+// Adds the states reachable from set without reading a byte, passing "^"
+// and "$" only where they hold, and keeps the states that read a byte,
+// accept or wait on an assertion, in sorted order.
+void LazyDfa::closure(std::vector<int>& set, bool lineBegin, bool lineEnd) const {
+    const std::vector<RegexProgram::State>& states = program.getStates();
+    std::vector<char> seen(states.size(), 0);
+    std::vector<int> stack(set.begin(), set.end());
+    set.clear();
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        if (index < 0 || seen[index]) {
+            continue;
+        }
+        seen[index] = 1;
+        const RegexProgram::State& state = states[index];
+        if (state.kind == RegexProgram::State::Split) {
+            stack.push_back(state.out1);
+            stack.push_back(state.out);
+            continue;
+        }
+        set.push_back(index);
+        if ((state.kind == RegexProgram::State::LineBegin && lineBegin) ||
+            (state.kind == RegexProgram::State::LineEnd && lineEnd)) {
+            stack.push_back(state.out);
+        }
+    }
+    std::sort(set.begin(), set.end());
+}
+
+int LazyDfa::addState(std::vector<int>& set, bool lineBegin) {
+    auto found = ids.find({set, lineBegin});
+    if (found != ids.end()) {
+        return found->second;
+    }
+    int id = static_cast<int>(sets.size());
+    ids.emplace(std::make_pair(set, lineBegin), id);
+    bool accept = false;
+    for (int index : set) {
+        accept = accept || program.getStates()[index].kind == RegexProgram::State::Match;
+    }
+    sets.push_back(std::move(set));
+    atLineStart.push_back(lineBegin ? 1 : 0);
+    accepting.push_back(accept ? 1 : 0);
+    table.resize(table.size() + columns, static_cast<int>(unknown));
+    return id;
+}
+
+void LazyDfa::reset() {
+    ids.clear();
+    sets.clear();
+    atLineStart.clear();
+    table.clear();
+    accepting.clear();
+    initial = {program.getStart()};
+    closure(initial, false, false);
+    std::vector<int> start = initial;
+    closure(start, true, false);
+    lineStartState = addState(start, true);
+}
+
+int LazyDfa::lineStart() const {
+    return lineStartState;
+}
+
+bool LazyDfa::accepts(int state) const {
+    return accepting[state] != 0;
+}
+
+// The state after reading byte symbol, or after the end of the line when
+// symbol is endOfLine.
+int LazyDfa::next(int state, int symbol) {
+    int cached = table[static_cast<std::size_t>(state) * columns + symbol];
+    if (cached != unknown) {
+        return cached;
+    }
+    std::vector<int> target;
+    if (symbol == endOfLine) {
+        target = sets[state];
+        closure(target, atLineStart[state] != 0, true);
+    } else {
+        const std::vector<RegexProgram::State>& states = program.getStates();
+        for (int index : sets[state]) {
+            const RegexProgram::State& nfaState = states[index];
+            if (nfaState.kind == RegexProgram::State::Set && program.getSet(nfaState.set)[symbol]) {
+                target.push_back(nfaState.out);
+            }
+        }
+        // Restarting at every position makes the search unanchored.
+        target.insert(target.end(), initial.begin(), initial.end());
+        closure(target, false, false);
+    }
+    if (sets.size() >= maxStates) {
+        // state is gone with the cache, so its transition is not recorded.
+        reset();
+        return addState(target, false);
+    }
+    int id = addState(target, false);
+    table[static_cast<std::size_t>(state) * columns + symbol] = id;
+    return id;
+}
+
+// Calls report(begin, end) for each line of [data, data + size) that has a
+// match, in order; lines end at '\n' or at the end of the text. report
+// returns false to stop the search.
+template <typename Report>
+void LazyDfa::searchLines(const char* data, std::size_t size, Report&& report) {
+    std::size_t begin = 0;
+    while (begin < size) {
+        const char* newline = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+        std::size_t end = newline == nullptr ? size : static_cast<std::size_t>(newline - data);
+        int state = lineStart();
+        bool matched = accepts(state);
+        for (std::size_t i = begin; i < end && !matched; ++i) {
+            unsigned char byte = static_cast<unsigned char>(data[i]);
+            int cached = table[static_cast<std::size_t>(state) * columns + byte];
+            state = cached != unknown ? cached : next(state, byte);
+            matched = accepting[state] != 0;
+        }
+        if (!matched) {
+            matched = accepts(next(state, endOfLine));
+        }
+        if (matched && !report(begin, end)) {
+            return;
+        }
+        begin = end + 1;
+    }
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_REGEX_H
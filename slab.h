@@ -0,0 +1,226 @@
+#ifndef LINUX_EMULATOR_SLAB_H
+#define LINUX_EMULATOR_SLAB_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Size-class slab allocator for tree nodes and inode records. Requests are
+// rounded up to a multiple of 16 bytes, up to 512, and served from
+// 64 KiB slabs through a per-class free list; larger requests fall through to
+// the system allocator. Freed blocks can be collected into a Batch and handed
+// back with a single splice, which is how whole subtrees are released.
+class SlabAllocator {
+public:
+    struct Batch {
+        void* head;
+        void* tail;
+        std::size_t count;
+        Batch();
+    };
+    SlabAllocator();
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+    ~SlabAllocator();
+    void* allocate(std::size_t);
+    void deallocate(void*, std::size_t);
+    void addToBatch(Batch&, void*) const;
+    void allocateBatch(Batch&, std::size_t, std::size_t);
+    void* takeFromBatch(Batch&);
+    void deallocateBatch(Batch&, std::size_t);
+    std::size_t getSlabCount() const;
+    std::size_t getReservedBytes() const;
+    std::size_t getLiveBlocks() const;
+    unsigned long long getAllocations() const;
+    unsigned long long getSystemAllocations() const;
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    static const std::size_t slabSize = 64 * 1024;
+    static const std::size_t minClassSize = 16;
+    static const std::size_t classCount = 32;
+    static std::size_t classIndex(std::size_t);
+    static std::size_t classSize(std::size_t);
+    void refill(std::size_t);
+    FreeBlock* freeLists[classCount];
+    std::vector<void*> slabs;
+    std::size_t liveBlocks;
+    unsigned long long allocations;
+    unsigned long long systemAllocations;
+};
+
+SlabAllocator::Batch::Batch() : head{nullptr}, tail{nullptr}, count{0} {}
+
+SlabAllocator::SlabAllocator() : freeLists{}, liveBlocks{0}, allocations{0}, systemAllocations{0} {}
+
+SlabAllocator::~SlabAllocator() {
+    for (void* slab : slabs) {
+        std::free(slab);
+    }
+}
+
+std::size_t SlabAllocator::classIndex(std::size_t size) {
+    return size == 0 ? 0 : (size - 1) / minClassSize;
+}
+
+std::size_t SlabAllocator::classSize(std::size_t index) {
+    return (index + 1) * minClassSize;
+}
+
+void SlabAllocator::refill(std::size_t index) {
+    void* slab = std::malloc(slabSize);
+    if (slab == nullptr) {
+        throw std::bad_alloc();
+    }
+    slabs.push_back(slab);
+    ++systemAllocations;
+    std::size_t blockSize = classSize(index);
+    char* bytes = static_cast<char*>(slab);
+    for (std::size_t offset = 0; offset + blockSize <= slabSize; offset += blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(bytes + offset);
+        block->next = freeLists[index];
+        freeLists[index] = block;
+    }
+}
+
+void* SlabAllocator::allocate(std::size_t size) {
+    ++allocations;
+    std::size_t index = classIndex(size);
+    if (index >= classCount) {
+        ++systemAllocations;
+        return ::operator new(size);
+    }
+    if (freeLists[index] == nullptr) {
+        refill(index);
+    }
+    FreeBlock* block = freeLists[index];
+    freeLists[index] = block->next;
+    ++liveBlocks;
+    return block;
+}
+
+void SlabAllocator::deallocate(void* pointer, std::size_t size) {
+    std::size_t index = classIndex(size);
+    if (index >= classCount) {
+        ::operator delete(pointer);
+        return;
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = freeLists[index];
+    freeLists[index] = block;
+    --liveBlocks;
+}
+
+void SlabAllocator::addToBatch(Batch& batch, void* pointer) const {
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = static_cast<FreeBlock*>(batch.head);
+    batch.head = block;
+    if (batch.tail == nullptr) {
+        batch.tail = block;
+    }
+    ++batch.count;
+}
+
+// Takes count blocks of size in one call: first whatever the free list holds,
+// then fresh slabs carved straight into the batch, so a large request costs
+// one system allocation per slab and lays its blocks out in address order.
+void SlabAllocator::allocateBatch(Batch& batch, std::size_t size, std::size_t count) {
+    allocations += count;
+    std::size_t index = classIndex(size);
+    if (index >= classCount) {
+        for (; count > 0; --count) {
+            ++systemAllocations;
+            addToBatch(batch, ::operator new(size));
+        }
+        return;
+    }
+    liveBlocks += count;
+    for (; count > 0 && freeLists[index] != nullptr; --count) {
+        FreeBlock* block = freeLists[index];
+        freeLists[index] = block->next;
+        addToBatch(batch, block);
+    }
+    std::size_t blockSize = classSize(index);
+    std::size_t blocksPerSlab = slabSize / blockSize;
+    while (count > 0) {
+        void* slab = std::malloc(slabSize);
+        if (slab == nullptr) {
+            throw std::bad_alloc();
+        }
+        slabs.push_back(slab);
+        ++systemAllocations;
+        char* bytes = static_cast<char*>(slab);
+        std::size_t used = std::min(count, blocksPerSlab);
+        // The batch is a stack, so push the blocks last to first.
+        for (std::size_t i = used; i-- > 0;) {
+            addToBatch(batch, bytes + i * blockSize);
+        }
+        for (std::size_t i = blocksPerSlab; i-- > used;) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(bytes + i * blockSize);
+            block->next = freeLists[index];
+            freeLists[index] = block;
+        }
+        count -= used;
+    }
+}
+
+// Pops one block of a batch filled by allocateBatch; the caller hands any
+// blocks left over back with deallocateBatch.
+void* SlabAllocator::takeFromBatch(Batch& batch) {
+    FreeBlock* block = static_cast<FreeBlock*>(batch.head);
+    batch.head = block->next;
+    if (batch.head == nullptr) {
+        batch.tail = nullptr;
+    }
+    --batch.count;
+    return block;
+}
+
+void SlabAllocator::deallocateBatch(Batch& batch, std::size_t size) {
+    if (batch.head == nullptr) {
+        return;
+    }
+    std::size_t index = classIndex(size);
+    if (index >= classCount) {
+        FreeBlock* block = static_cast<FreeBlock*>(batch.head);
+        while (block != nullptr) {
+            FreeBlock* next = block->next;
+            ::operator delete(block);
+            block = next;
+        }
+    } else {
+        static_cast<FreeBlock*>(batch.tail)->next = freeLists[index];
+        freeLists[index] = static_cast<FreeBlock*>(batch.head);
+        liveBlocks -= batch.count;
+    }
+    batch = Batch();
+}
+
+std::size_t SlabAllocator::getSlabCount() const {
+    return slabs.size();
+}
+
+std::size_t SlabAllocator::getReservedBytes() const {
+    return slabs.size() * slabSize;
+}
+
+std::size_t SlabAllocator::getLiveBlocks() const {
+    return liveBlocks;
+}
+
+unsigned long long SlabAllocator::getAllocations() const {
+    return allocations;
+}
+
+unsigned long long SlabAllocator::getSystemAllocations() const {
+    return systemAllocations;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_SLAB_H
@@ -0,0 +1,507 @@
+#ifndef LINUX_EMULATOR_SORT_H
+#define LINUX_EMULATOR_SORT_H
+
+#include "buffer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace LinuxEmulator {
+
+// Splits a file's content, given as the views of its extents, into lines
+// without their newlines. A line that lies in one extent is returned as a
+// view into it; one that spans extents is joined in the reader's own
+// buffer, which the next call reuses. A missing final newline is implied.
+class LineReader {
+public:
+    explicit LineReader(const std::vector<std::string_view>&);
+    bool next(std::string_view&);
+    bool wasJoined() const;
+private:
+    const std::vector<std::string_view>& pieces;
+    std::size_t piece;
+    std::size_t offset;
+    std::string joined;
+    bool joinedLast;
+};
+
+// Output stream buffer that appends to a ContentBuffer a block at a time,
+// so a large result is built in place rather than in a string first.
+class ContentWriter : public std::streambuf {
+public:
+    explicit ContentWriter(ContentBuffer&);
+    ~ContentWriter() override;
+protected:
+    int_type overflow(int_type) override;
+    int sync() override;
+private:
+    static constexpr std::size_t blockSize = 64 << 10;
+    ContentBuffer& content;
+    std::vector<char> block;
+};
+
+// sort over the lines of a list of files. Lines are not copied: each one is
+// indexed by a record with views of the line and its key and the key's
+// numeric value. A run of records is sorted on a pool of threads, one
+// contiguous slice per thread, and the slices are merged through a heap as
+// the run is written out. Ties keep the input order, so -u keeps the first
+// line of each group as GNU sort does.
+//
+// Records take about 60 bytes a line with the merge buffer of the sort, so
+// a large log needs more for its index than for its text. Once a run holds
+// as many records as memoryBudget allows, it is written sorted to a
+// temporary host file, and the runs are merged from there at the end, each
+// read through a small buffer. What the sort needs on top of the contents
+// is then bounded by the budget however large the input.
+class TextSort {
+public:
+    struct Options {
+        bool numeric;
+        bool reverse;
+        bool unique;
+        int keyStart;
+        int keyEnd;
+        std::size_t memoryBudget;
+        Options();
+    };
+    static unsigned defaultThreads();
+    static bool run(const std::vector<std::vector<std::string_view>>&, const Options&, unsigned, std::ostream&,
+                    std::string&);
+private:
+    static constexpr std::size_t minSlice = 16384;
+    static constexpr std::size_t readBlock = 64 << 10;
+    struct Line {
+        std::string_view text;
+        std::string_view key;
+        double number;
+    };
+    struct Slice {
+        Line* next;
+        Line* end;
+        const Line* current() const;
+        void advance();
+    };
+    // Reads the lines of one spilled run back with pread, so that all runs
+    // share the file without seeking it.
+    class RunReader {
+    public:
+        RunReader(const TextSort&, int, std::uint64_t, std::uint64_t);
+        const Line* current() const;
+        void advance();
+        bool failed() const;
+    private:
+        const TextSort& sort;
+        int fd;
+        std::uint64_t position;
+        std::uint64_t end;
+        std::vector<char> buffer;
+        std::size_t start;
+        std::size_t filled;
+        Line line;
+        bool valid;
+        bool error;
+    };
+    // Writes merged lines, dropping those equal to the last one under -u.
+    struct Output {
+        std::function<void(std::string_view)> write;
+        bool any;
+        std::string lastText;
+        Line last;
+    };
+    TextSort(const Options&, unsigned);
+    static bool isBlank(char);
+    static double parseNumber(std::string_view);
+    std::string_view key(std::string_view) const;
+    Line index(std::string_view) const;
+    int compare(const Line&, const Line&) const;
+    void sortRun(std::vector<Line>&, std::vector<Slice>&) const;
+    void emit(Output&, const Line&) const;
+    template <typename Source>
+    void merge(std::vector<Source>&, Output&) const;
+    Options options;
+    unsigned threads;
+};
+
+LineReader::LineReader(const std::vector<std::string_view>& p) : pieces{p}, piece{0}, offset{0}, joinedLast{false} {}
+
+bool LineReader::next(std::string_view& line) {
+    joinedLast = false;
+    while (piece < pieces.size()) {
+        std::string_view rest = pieces[piece].substr(offset);
+        std::size_t end = rest.find('\n');
+        if (end == std::string_view::npos) {
+            // The line goes on in the next extent.
+            if (!joinedLast) {
+                joined.clear();
+            }
+            joined.append(rest);
+            joinedLast = true;
+            ++piece;
+            offset = 0;
+            continue;
+        }
+        offset += end + 1;
+        if (offset == pieces[piece].size()) {
+            ++piece;
+            offset = 0;
+        }
+        if (joinedLast) {
+            joined.append(rest.substr(0, end));
+            line = joined;
+        } else {
+            line = rest.substr(0, end);
+        }
+        return true;
+    }
+    if (joinedLast) {
+        line = joined;
+    }
+    return joinedLast;
+}
+
+bool LineReader::wasJoined() const {
+    return joinedLast;
+}
+
+ContentWriter::ContentWriter(ContentBuffer& c) : content{c}, block(blockSize) {
+    setp(block.data(), block.data() + block.size());
+}
+
+ContentWriter::~ContentWriter() {
+    sync();
+}
+
+ContentWriter::int_type ContentWriter::overflow(int_type c) {
+    sync();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int ContentWriter::sync() {
+    content.append(std::string_view(pbase(), static_cast<std::size_t>(pptr() - pbase())));
+    setp(block.data(), block.data() + block.size());
+    return 0;
+}
+
+TextSort::Options::Options()
+    : numeric{false}, reverse{false}, unique{false}, keyStart{0}, keyEnd{0}, memoryBudget{64 << 20} {}
+
+TextSort::TextSort(const Options& o, unsigned t) : options{o}, threads{std::max(t, 1U)} {}
+
+unsigned TextSort::defaultThreads() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::min(std::max(cores, 1U), 8U);
+}
+
+const TextSort::Line* TextSort::Slice::current() const {
+    return next == end ? nullptr : next;
+}
+
+void TextSort::Slice::advance() {
+    ++next;
+}
+
+TextSort::RunReader::RunReader(const TextSort& s, int f, std::uint64_t begin, std::uint64_t e)
+    : sort{s}, fd{f}, position{begin}, end{e}, buffer(readBlock), start{0}, filled{0}, line{}, valid{false},
+      error{false} {
+    advance();
+}
+
+const TextSort::Line* TextSort::RunReader::current() const {
+    return valid ? &line : nullptr;
+}
+
+// Every line of a run ends with a newline; a line longer than the buffer
+// grows it.
+void TextSort::RunReader::advance() {
+    while (true) {
+        const char* begin = buffer.data() + start;
+        const void* found = std::memchr(begin, '\n', filled - start);
+        if (found != nullptr) {
+            std::size_t length = static_cast<std::size_t>(static_cast<const char*>(found) - begin);
+            line = sort.index(std::string_view(begin, length));
+            start += length + 1;
+            valid = true;
+            return;
+        }
+        if (position == end) {
+            valid = false;
+            return;
+        }
+        std::memmove(buffer.data(), begin, filled - start);
+        filled -= start;
+        start = 0;
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        std::size_t wanted = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size() - filled, end - position));
+        ssize_t got = ::pread(fd, buffer.data() + filled, wanted, static_cast<off_t>(position));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            valid = false;
+            error = true;
+            return;
+        }
+        position += static_cast<std::uint64_t>(got);
+        filled += static_cast<std::size_t>(got);
+    }
+}
+
+bool TextSort::RunReader::failed() const {
+    return error;
+}
+
+bool TextSort::isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Leading blanks, an optional minus sign, digits and a decimal point, as -n
+// reads them in the C locale; anything else ends the number, and a line
+// without one counts as zero.
+double TextSort::parseNumber(std::string_view text) {
+    std::size_t i = 0;
+    while (i < text.size() && isBlank(text[i])) {
+        ++i;
+    }
+    bool negative = i < text.size() && text[i] == '-';
+    i += negative ? 1 : 0;
+    double value = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+        value = value * 10 + (text[i] - '0');
+    }
+    if (i < text.size() && text[i] == '.') {
+        double scale = 1;
+        for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+            scale /= 10;
+            value += (text[i] - '0') * scale;
+        }
+    }
+    return negative ? -value : value;
+}
+
+// Fields keyStart to keyEnd (to the end of the line when keyEnd is 0),
+// split at runs of blanks. The blanks before the first field are skipped,
+// as with -b.
+std::string_view TextSort::key(std::string_view text) const {
+    if (options.keyStart == 0) {
+        return text;
+    }
+    std::size_t begin = text.size();
+    std::size_t end = text.size();
+    std::size_t i = 0;
+    for (int field = 1; i < text.size(); ++field) {
+        while (i < text.size() && isBlank(text[i])) {
+            ++i;
+        }
+        if (field == options.keyStart) {
+            begin = i;
+        }
+        while (i < text.size() && !isBlank(text[i])) {
+            ++i;
+        }
+        if (field == options.keyEnd) {
+            end = i;
+            break;
+        }
+    }
+    return begin < end ? text.substr(begin, end - begin) : std::string_view();
+}
+
+TextSort::Line TextSort::index(std::string_view text) const {
+    std::string_view field = key(text);
+    return {text, field, options.numeric ? parseNumber(field) : 0};
+}
+
+// Keys first; lines with equal keys are ordered by their whole text unless
+// -u asks for one line per key. -r reverses both.
+int TextSort::compare(const Line& a, const Line& b) const {
+    int order;
+    if (options.numeric) {
+        order = a.number < b.number ? -1 : a.number > b.number ? 1 : 0;
+    } else {
+        order = a.key.compare(b.key);
+    }
+    if (order == 0 && !options.unique && (options.numeric || options.keyStart != 0)) {
+        order = a.text.compare(b.text);
+    }
+    order = (order > 0) - (order < 0);
+    return options.reverse ? -order : order;
+}
+
+// Cuts lines into one slice per thread and sorts the slices in parallel.
+void TextSort::sortRun(std::vector<Line>& lines, std::vector<Slice>& slices) const {
+    std::size_t count = std::max<std::size_t>(1, std::min<std::size_t>(threads, lines.size() / minSlice));
+    slices.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+        slices.push_back({lines.data() + lines.size() * i / count, lines.data() + lines.size() * (i + 1) / count});
+    }
+    auto sortSlice = [this](Slice slice) {
+        std::stable_sort(slice.next, slice.end, [this](const Line& a, const Line& b) { return compare(a, b) < 0; });
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < count; ++i) {
+        pool.emplace_back(sortSlice, slices[i]);
+    }
+    sortSlice(slices[0]);
+    for (std::thread& worker : pool) {
+        worker.join();
+    }
+}
+
+void TextSort::emit(Output& output, const Line& line) const {
+    if (options.unique) {
+        if (output.any && compare(output.last, line) == 0) {
+            return;
+        }
+        output.lastText.assign(line.text);
+        output.last = index(output.lastText);
+    }
+    output.any = true;
+    output.write(line.text);
+}
+
+// Merges sorted sources through a heap. Sources are numbered in input order
+// and ties go to the lower number, which keeps the merge stable.
+template <typename Source>
+void TextSort::merge(std::vector<Source>& sources, Output& output) const {
+    auto after = [&](std::size_t a, std::size_t b) {
+        int order = compare(*sources[a].current(), *sources[b].current());
+        return order > 0 || (order == 0 && a > b);
+    };
+    std::vector<std::size_t> heap;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].current() != nullptr) {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), after);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        Source& source = sources[heap.back()];
+        emit(output, *source.current());
+        source.advance();
+        if (source.current() != nullptr) {
+            std::push_heap(heap.begin(), heap.end(), after);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
+// Writes the sorted lines of inputs, each given as the views of a file's
+// extents, to out.
+bool TextSort::run(const std::vector<std::vector<std::string_view>>& inputs, const Options& options, unsigned threads,
+                   std::ostream& out, std::string& error) {
+    TextSort sort(options, threads);
+    // stable_sort merges through a buffer of half the records.
+    std::size_t runLines = std::max<std::size_t>(options.memoryBudget / (sizeof(Line) + sizeof(Line) / 2), minSlice);
+    std::vector<Line> lines;
+    std::vector<Slice> slices;
+    std::deque<std::string> joined;
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> spill(nullptr, &std::fclose);
+    std::vector<std::uint64_t> runEnds;
+    std::uint64_t spilled = 0;
+    Output toSpill{[&](std::string_view text) {
+        std::fwrite(text.data(), 1, text.size(), spill.get());
+        std::fputc('\n', spill.get());
+        spilled += text.size() + 1;
+    }, false, {}, {}};
+    auto spillRun = [&]() {
+        if (!spill) {
+            spill.reset(std::tmpfile());
+            if (!spill) {
+                return false;
+            }
+            std::setvbuf(spill.get(), nullptr, _IOFBF, 1 << 20);
+        }
+        sort.sortRun(lines, slices);
+        toSpill.any = false;
+        sort.merge(slices, toSpill);
+        runEnds.push_back(spilled);
+        lines.clear();
+        joined.clear();
+        return true;
+    };
+
+    for (const std::vector<std::string_view>& pieces : inputs) {
+        LineReader reader(pieces);
+        std::string_view text;
+        while (reader.next(text)) {
+            if (reader.wasJoined()) {
+                joined.emplace_back(text);
+                text = joined.back();
+            }
+            // Grow through halves of the run size, so that the last step
+            // needs no more than the merge buffer of the sort does.
+            if (lines.size() == lines.capacity()) {
+                std::size_t capacity = runLines;
+                while (capacity / 2 > lines.size() && capacity / 2 >= 1024) {
+                    capacity /= 2;
+                }
+                lines.reserve(capacity);
+            }
+            lines.push_back(sort.index(text));
+            if (lines.size() == runLines && !spillRun()) {
+                error = std::string("cannot create temporary file: ") + std::strerror(errno);
+                return false;
+            }
+        }
+    }
+
+    Output toOut{[&](std::string_view text) {
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.put('\n');
+    }, false, {}, {}};
+    if (!spill) {
+        sort.sortRun(lines, slices);
+        sort.merge(slices, toOut);
+        out.flush();
+        return true;
+    }
+    if (!lines.empty()) {
+        spillRun();
+    }
+    std::vector<Line>().swap(lines);
+    if (std::fflush(spill.get()) != 0 || std::ferror(spill.get())) {
+        error = std::string("cannot write temporary file: ") + std::strerror(errno);
+        return false;
+    }
+    std::vector<RunReader> runs;
+    runs.reserve(runEnds.size());
+    for (std::size_t i = 0; i < runEnds.size(); ++i) {
+        runs.emplace_back(sort, fileno(spill.get()), i == 0 ? 0 : runEnds[i - 1], runEnds[i]);
+    }
+    sort.merge(runs, toOut);
+    out.flush();
+    for (const RunReader& reader : runs) {
+        if (reader.failed()) {
+            error = "cannot read temporary file";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_SORT_H
@@ -0,0 +1,59 @@
+#ifndef LINUX_EMULATOR_STRINGPOOL_H
+#define LINUX_EMULATOR_STRINGPOOL_H
+
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+
+namespace LinuxEmulator {
+
+// Reference-counted pool of interned strings. Each distinct name is stored
+// once and directory entries hold a pointer to the pooled copy, which stays
+// valid until the last reference is released.
+class StringPool {
+public:
+    StringPool();
+    const std::string* intern(const std::string&);
+    void release(const std::string*);
+    std::size_t size() const;
+    std::size_t getBytes() const;
+private:
+    std::unordered_map<std::string, std::size_t> strings;
+    std::size_t bytes;
+};
+
+StringPool::StringPool() : bytes{0} {}
+
+// Names are mostly already pooled, so look before emplace() allocates a node.
+const std::string* StringPool::intern(const std::string& value) {
+    auto it = strings.find(value);
+    if (it == strings.end()) {
+        it = strings.emplace(value, 0).first;
+        bytes += value.size();
+    }
+    ++it->second;
+    return &it->first;
+}
+
+void StringPool::release(const std::string* value) {
+    auto it = strings.find(*value);
+    if (it == strings.end()) {
+        return;
+    }
+    if (--it->second == 0) {
+        bytes -= it->first.size();
+        strings.erase(it);
+    }
+}
+
+std::size_t StringPool::size() const {
+    return strings.size();
+}
+
+std::size_t StringPool::getBytes() const {
+    return bytes;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_STRINGPOOL_H
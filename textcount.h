@@ -0,0 +1,130 @@
+#ifndef LINUX_EMULATOR_TEXTCOUNT_H
+#define LINUX_EMULATOR_TEXTCOUNT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace LinuxEmulator {
+
+// What wc reports for a text: newline characters, words and bytes. A word is
+// a maximal run of bytes other than the C-locale whitespace " \t\n\v\f\r".
+struct TextCounts {
+    std::uint64_t lines;
+    std::uint64_t words;
+    std::uint64_t bytes;
+    TextCounts();
+    TextCounts& operator+=(const TextCounts&);
+};
+
+// One-pass counter over a text that arrives in pieces (the extents of a
+// ContentBuffer). Blocks of 32 or 16 bytes are classified with AVX2 or SSE2
+// compares into newline and whitespace bitmasks, and words are counted as
+// non-space bytes preceded by a space; the word state carries across blocks
+// and pieces. The vector paths are chosen at compile time (-mavx2 or
+// -march=native for AVX2; SSE2 is always there on x86-64), with a scalar loop
+// for the tail and for other targets.
+class TextCounter {
+public:
+    TextCounter();
+    void update(const char*, std::size_t);
+    const TextCounts& getCounts() const;
+private:
+    static bool isSpace(char);
+    static unsigned popcount(std::uint64_t);
+    void addBlock(std::uint64_t, std::uint64_t, unsigned);
+    TextCounts counts;
+    bool inWord;
+};
+
+TextCounts::TextCounts() : lines{0}, words{0}, bytes{0} {}
+
+TextCounts& TextCounts::operator+=(const TextCounts& other) {
+    lines += other.lines;
+    words += other.words;
+    bytes += other.bytes;
+    return *this;
+}
+
+TextCounter::TextCounter() : inWord{false} {}
+
+bool TextCounter::isSpace(char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+unsigned TextCounter::popcount(std::uint64_t x) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_popcountll(x));
+#else
+    unsigned count = 0;
+    for (; x != 0; x &= x - 1) {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Bit i of the masks describes byte i of a block of the given width.
+void TextCounter::addBlock(std::uint64_t newlines, std::uint64_t spaces, unsigned width) {
+    std::uint64_t block = width == 64 ? ~0ULL : (1ULL << width) - 1;
+    std::uint64_t precededBySpace = (spaces << 1) | (inWord ? 0 : 1);
+    counts.lines += popcount(newlines);
+    counts.words += popcount(~spaces & precededBySpace & block);
+    inWord = ((spaces >> (width - 1)) & 1) == 0;
+}
+
+void TextCounter::update(const char* data, std::size_t size) {
+    counts.bytes += size;
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i newline32 = _mm256_set1_epi8('\n');
+    const __m256i blank32 = _mm256_set1_epi8(' ');
+    const __m256i tab32 = _mm256_set1_epi8('\t');
+    const __m256i controlRange32 = _mm256_set1_epi8('\r' - '\t');
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        // \t..\r are the bytes whose distance from \t is at most 4, unsigned.
+        __m256i fromTab = _mm256_sub_epi8(bytes, tab32);
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(fromTab, controlRange32), fromTab);
+        __m256i space = _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, blank32));
+        std::uint32_t newlines = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline32)));
+        std::uint32_t spaces = static_cast<std::uint32_t>(_mm256_movemask_epi8(space));
+        addBlock(newlines, spaces, 32);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i newline16 = _mm_set1_epi8('\n');
+    const __m128i blank16 = _mm_set1_epi8(' ');
+    const __m128i tab16 = _mm_set1_epi8('\t');
+    const __m128i controlRange16 = _mm_set1_epi8('\r' - '\t');
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i fromTab = _mm_sub_epi8(bytes, tab16);
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(fromTab, controlRange16), fromTab);
+        __m128i space = _mm_or_si128(control, _mm_cmpeq_epi8(bytes, blank16));
+        std::uint32_t newlines = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline16)));
+        std::uint32_t spaces = static_cast<std::uint32_t>(_mm_movemask_epi8(space));
+        addBlock(newlines, spaces, 16);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (isSpace(data[i])) {
+            inWord = false;
+            counts.lines += data[i] == '\n' ? 1 : 0;
+        } else {
+            counts.words += inWord ? 0 : 1;
+            inWord = true;
+        }
+    }
+}
+
+const TextCounts& TextCounter::getCounts() const {
+    return counts;
+}
+
+} // namespace LinuxEmulator
+
+#endif // LINUX_EMULATOR_TEXTCOUNT_H